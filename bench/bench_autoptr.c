@@ -0,0 +1,279 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "bench_common.h"
+#include <libautoptr/autoptr.h>
+#include <libautoptr/autoptr_channel.h>
+#include <libautoptr/autoptr_reclaim.h>
+#include <libautoptr/autoptr_segvec.h>
+#include <libautoptr/autoptr_slice.h>
+#include <libautoptr/autoptr_teardown.h>
+#include <libautoptr/autoptr_tl.h>
+
+#define NUM_ITER 1000000
+#define NUM_CONTENDED_ITER 200000
+#define VECTOR_SIZE 100000
+#define NUM_VECTOR_ROUNDS 20
+#define SEGVEC_CHUNK_LEN 1024
+#define TL_BATCH 1000 // Binds per flush of the coalescing buffer
+#define TEARDOWN_THRESHOLD 10000 // Objects above which independent sets are torn down in parallel
+
+struct obj {
+        struct autoptr __autoptr;
+        size_t data;
+};
+
+static void obj_dtor(struct obj *o)
+{
+        if (!autoptr_destroy_ok(o)) {
+                autoptr_release(o);
+                return;
+        }
+        autoptr_dtor(o);
+}
+
+static struct obj *obj_valloc(size_t n)
+{
+        struct obj *o = calloc(n, sizeof(*o));
+
+        for (size_t i = 0; i < n; ++i)
+                autoptr_ctor(o + i, sizeof(*o), (void (*)(void *))obj_dtor);
+        autoptr_set_allocd(o, true);
+        if (n > 1)
+                autoptr_set_managed(o, n);
+
+        return o;
+}
+
+/*
+ * Single-thread bind/unbind pairs on a private object
+ */
+static void run_bind_unbind(void)
+{
+        struct obj *o = obj_valloc(1);
+
+        const double start = bench_now_ns();
+        for (size_t n = 0; n < NUM_ITER; ++n) {
+                void *p = autoptr_bind(o);
+                autoptr_unbind(&p);
+        }
+
+        bench_report("bind_unbind", 1, NUM_ITER, bench_now_ns() - start);
+
+        autoptr_free_obj((void **)&o);
+}
+
+/*
+ * Allocation, construction and destruction of single objects in separate steps and in one call
+ */
+static void run_construct(void)
+{
+        double start = bench_now_ns();
+        for (size_t n = 0; n < NUM_ITER; ++n) {
+                struct obj *o = obj_valloc(1);
+                autoptr_free_obj((void **)&o);
+        }
+        bench_report("construct", 1, NUM_ITER, bench_now_ns() - start);
+
+        start = bench_now_ns();
+        for (size_t n = 0; n < NUM_ITER; ++n) {
+                struct obj *o = autoptr_alloc(sizeof(*o), (void (*)(void *))obj_dtor);
+                autoptr_free_obj((void **)&o);
+        }
+        bench_report("construct_alloc", 1, NUM_ITER, bench_now_ns() - start);
+}
+
+/*
+ * Handoffs of a reference through a channel: moved, and bound on the sending side and unbound on the receiving one
+ */
+static void run_channel(void)
+{
+        struct obj *o              = obj_valloc(1);
+        struct autoptr_channel *ch = autoptr_channel_create(16);
+        void *p                    = autoptr_bind(o);
+
+        double start = bench_now_ns();
+        for (size_t n = 0; n < NUM_ITER; ++n) {
+                autoptr_channel_send(ch, &p);
+                p = autoptr_channel_recv(ch);
+        }
+        bench_report("channel_move", 1, NUM_ITER, bench_now_ns() - start);
+
+        start = bench_now_ns();
+        for (size_t n = 0; n < NUM_ITER; ++n) {
+                void *q = autoptr_bind(o);
+                autoptr_channel_send(ch, &q);
+                q = autoptr_channel_recv(ch);
+                autoptr_unbind(&q);
+        }
+        bench_report("channel_bind_unbind", 1, NUM_ITER, bench_now_ns() - start);
+
+        autoptr_unbind(&p);
+        autoptr_channel_destroy(ch);
+        autoptr_free_obj((void **)&o);
+}
+
+#if AUTOPTR_THREAD_SAFE
+static void *bind_unbind(void *arg)
+{
+        for (size_t n = 0; n < NUM_CONTENDED_ITER; ++n) {
+                void *p = autoptr_bind(arg);
+                autoptr_unbind(&p);
+        }
+        return NULL;
+}
+
+static void *bind_unbind_tl(void *arg)
+{
+        for (size_t n = 0; n < NUM_CONTENDED_ITER; ++n) {
+                void *p = autoptr_tl_bind(arg);
+                autoptr_tl_unbind(&p);
+                if (n % TL_BATCH == TL_BATCH - 1)
+                        autoptr_tl_flush();
+        }
+        autoptr_tl_flush();
+        return NULL;
+}
+
+/*
+ * Bind/unbind pairs of num_threads threads on one shared object
+ */
+static void run_contended(size_t num_threads)
+{
+        struct obj *o = obj_valloc(1);
+
+        bench_report("bind_unbind_contended", num_threads, num_threads * NUM_CONTENDED_ITER,
+                     bench_run_threads(num_threads, bind_unbind, o));
+        bench_report("bind_unbind_contended_tl", num_threads, num_threads * NUM_CONTENDED_ITER,
+                     bench_run_threads(num_threads, bind_unbind_tl, o));
+
+        autoptr_free_obj((void **)&o);
+}
+
+#if AUTOPTR_SHARDED
+/*
+ * Bind/unbind pairs of num_threads threads on one shared object with a sharded count
+ */
+static void run_contended_sharded(size_t num_threads)
+{
+        struct obj *o = obj_valloc(1);
+        autoptr_set_sharded(o);
+
+        bench_report("bind_unbind_contended_sharded", num_threads, num_threads * NUM_CONTENDED_ITER,
+                     bench_run_threads(num_threads, bind_unbind, o));
+
+        autoptr_free_obj((void **)&o);
+}
+#endif
+#endif // AUTOPTR_THREAD_SAFE
+
+/*
+ * Binding and unbinding a reference to every element of a managed vector (and a slice over all of them), per
+ * element
+ */
+static void run_vector(void)
+{
+        struct obj *v    = obj_valloc(VECTOR_SIZE);
+        void **list      = malloc(VECTOR_SIZE * sizeof(*list));
+        const size_t ops = (size_t)NUM_VECTOR_ROUNDS * VECTOR_SIZE;
+
+        double start = bench_now_ns();
+        for (size_t n = 0; n < NUM_VECTOR_ROUNDS; ++n) {
+                autoptr_vbindl(v, VECTOR_SIZE, list);
+                autoptr_lunbind(list, VECTOR_SIZE);
+        }
+        bench_report("vbindl_lunbind", 1, ops, bench_now_ns() - start);
+
+        start = bench_now_ns();
+        for (size_t n = 0; n < NUM_VECTOR_ROUNDS; ++n) {
+                autoptr_vbindl(v, VECTOR_SIZE, list);
+                autoptr_lunbind_batch(list, VECTOR_SIZE);
+        }
+        bench_report("vbindl_lunbind_batch", 1, ops, bench_now_ns() - start);
+
+        // A slice binds the whole range at once, so each round is a single operation
+        start = bench_now_ns();
+        for (size_t n = 0; n < NUM_VECTOR_ROUNDS; ++n) {
+                struct autoptr_slice s = autoptr_slice_bind(v, 0, VECTOR_SIZE);
+                autoptr_slice_unbind(&s);
+        }
+        bench_report("slice_bind_unbind", 1, NUM_VECTOR_ROUNDS, bench_now_ns() - start);
+
+        // Growing one object at a time, chunks destroyed included
+        start = bench_now_ns();
+        for (size_t n = 0; n < NUM_VECTOR_ROUNDS; ++n) {
+                struct autoptr_segvec sv;
+
+                autoptr_segvec_init(&sv, sizeof(struct obj), SEGVEC_CHUNK_LEN, NULL, (void (*)(void *))obj_dtor);
+                for (size_t i = 0; i < VECTOR_SIZE; ++i)
+                        ((struct obj *)autoptr_segvec_push(&sv))->data = i;
+                autoptr_segvec_destroy(&sv);
+        }
+        bench_report("segvec_push", 1, ops, bench_now_ns() - start);
+
+        free(list);
+        autoptr_free_obj((void **)&v);
+}
+
+/*
+ * Time of the unbind that releases the last reference of a managed set, per element
+ */
+static void run_teardown(const char *name, size_t num_managed, void (*set_flag)(void *))
+{
+        struct obj *v = obj_valloc(num_managed);
+        void *p       = autoptr_bind(v);
+
+        if (set_flag != NULL)
+                set_flag(v);
+
+        // Hand the set over to the bound reference; its unbind destroys the set
+        autoptr_free_obj((void **)&v);
+
+        const double start = bench_now_ns();
+        autoptr_unbind(&p);
+        bench_report(name, 1, num_managed, bench_now_ns() - start);
+}
+
+int main(int argc, char **argv)
+{
+        static const size_t num_managed[] = {10, 100, 1000, 10000, 100000, 1000000};
+
+        bench_header();
+
+        run_bind_unbind();
+        run_construct();
+        run_channel();
+#if AUTOPTR_THREAD_SAFE
+        static const size_t num_threads[] = {1, 2, 4, 8, 16};
+
+        for (size_t n = 0; n < sizeof(num_threads) / sizeof(num_threads[0]); ++n)
+                run_contended(num_threads[n]);
+#if AUTOPTR_SHARDED
+        for (size_t n = 0; n < sizeof(num_threads) / sizeof(num_threads[0]); ++n)
+                run_contended_sharded(num_threads[n]);
+#endif
+#endif
+
+        run_vector();
+
+        for (size_t n = 0; n < sizeof(num_managed) / sizeof(num_managed[0]); ++n)
+                run_teardown("teardown", num_managed[n], NULL);
+        for (size_t n = 0; n < sizeof(num_managed) / sizeof(num_managed[0]); ++n)
+                run_teardown("teardown_trivial", num_managed[n], autoptr_set_trivial);
+
+        // With deferred reclaim the unbind only queues the set
+        autoptr_reclaim_start(64, false);
+        for (size_t n = 0; n < sizeof(num_managed) / sizeof(num_managed[0]); ++n)
+                run_teardown("teardown_deferred", num_managed[n], NULL);
+        autoptr_reclaim_stop();
+
+        // Independent sets above the threshold are split across the teardown workers
+        autoptr_teardown_start(0, TEARDOWN_THRESHOLD);
+        for (size_t n = 0; n < sizeof(num_managed) / sizeof(num_managed[0]); ++n)
+                run_teardown("teardown_parallel", num_managed[n], autoptr_set_independent);
+        autoptr_teardown_stop();
+
+        return 0;
+}
@@ -0,0 +1,81 @@
+#ifndef __BENCH_COMMON_H__
+#define __BENCH_COMMON_H__
+
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <libautoptr/autoptr.h>
+
+static inline double bench_now_ns(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/*
+ * Runs fn on num_threads threads started together and returns the elapsed wall time in nanoseconds
+ */
+static inline double bench_run_threads(size_t num_threads, void *(*fn)(void *), void *arg)
+{
+        pthread_t threads[num_threads];
+
+        const double start = bench_now_ns();
+        for (size_t n = 0; n < num_threads; ++n)
+                pthread_create(&threads[n], NULL, fn, arg);
+        for (size_t n = 0; n < num_threads; ++n)
+                pthread_join(threads[n], NULL);
+        return bench_now_ns() - start;
+}
+
+/*
+ * Reference counting mode of the build, reported with every result so that runs of different builds can be compared
+ */
+#if AUTOPTR_BIASED
+#define BENCH_MODE "biased"
+#elif AUTOPTR_SHARDED
+#define BENCH_MODE "sharded"
+#elif AUTOPTR_COMPACT
+#define BENCH_MODE "compact"
+#elif AUTOPTR_ATOMIC
+#define BENCH_MODE "atomic"
+#elif AUTOPTR_LOCKING == AUTOPTR_LOCKING_SPIN
+#define BENCH_MODE "spin"
+#elif AUTOPTR_LOCKING == AUTOPTR_LOCKING_NONE
+#define BENCH_MODE "nolock"
+#else
+#define BENCH_MODE "mutex"
+#endif
+// Lock of the object header of builds with atomic counts, if not the default mutex
+#if AUTOPTR_ATOMIC && !AUTOPTR_COMPACT && AUTOPTR_LOCKING == AUTOPTR_LOCKING_SPIN
+#define BENCH_MODE_LOCKING "+spin"
+#elif AUTOPTR_ATOMIC && !AUTOPTR_COMPACT && AUTOPTR_LOCKING == AUTOPTR_LOCKING_NONE
+#define BENCH_MODE_LOCKING "+nolock"
+#else
+#define BENCH_MODE_LOCKING ""
+#endif
+#if AUTOPTR_STATS
+#define BENCH_MODE_STATS "+stats"
+#else
+#define BENCH_MODE_STATS ""
+#endif
+#if AUTOPTR_TRACE
+#define BENCH_MODE_TRACE "+trace"
+#else
+#define BENCH_MODE_TRACE ""
+#endif
+
+static inline void bench_header(void)
+{
+        printf("benchmark,mode,threads,ops,ns_per_op\n");
+}
+
+static inline void bench_report(const char *name, size_t num_threads, size_t ops, double elapsed_ns)
+{
+        printf("%s,%s,%zu,%zu,%.2f\n", name, BENCH_MODE BENCH_MODE_LOCKING BENCH_MODE_STATS BENCH_MODE_TRACE,
+               num_threads, ops, elapsed_ns / (double)ops);
+        fflush(stdout);
+}
+
+#endif // __BENCH_COMMON_H__
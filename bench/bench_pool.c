@@ -0,0 +1,76 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "bench_common.h"
+#include <libautoptr/autoptr.h>
+#include <libautoptr/autoptr_pool.h>
+
+#define NUM_ITER 20000
+#define NUM_LIVE 64 // Objects alive at once per thread
+
+struct obj {
+        struct autoptr __autoptr;
+        char data[48];
+};
+
+static void obj_dtor(struct obj *o)
+{
+        if (!autoptr_destroy_ok(o)) {
+                autoptr_release(o);
+                return;
+        }
+        autoptr_dtor(o);
+}
+
+static void *churn_calloc(void *arg)
+{
+        struct obj *o[NUM_LIVE];
+
+        for (size_t i = 0; i < NUM_ITER; ++i) {
+                for (size_t n = 0; n < NUM_LIVE; ++n) {
+                        o[n] = calloc(1, sizeof(*o[n]));
+                        autoptr_ctor(o[n], sizeof(*o[n]), (void (*)(void *))obj_dtor);
+                        autoptr_set_allocd(o[n], true);
+                }
+                for (size_t n = 0; n < NUM_LIVE; ++n)
+                        autoptr_free_obj((void **)&o[n]);
+        }
+        return NULL;
+}
+
+static void *churn_pool(void *arg)
+{
+        struct autoptr_pool *pool = arg;
+        struct obj *o[NUM_LIVE];
+
+        for (size_t i = 0; i < NUM_ITER; ++i) {
+                for (size_t n = 0; n < NUM_LIVE; ++n) {
+                        o[n] = autoptr_pool_alloc(pool);
+                        autoptr_ctor(o[n], sizeof(*o[n]), (void (*)(void *))obj_dtor);
+                        autoptr_pool_set_allocd(o[n]);
+                }
+                for (size_t n = 0; n < NUM_LIVE; ++n)
+                        autoptr_free_obj((void **)&o[n]);
+        }
+        return NULL;
+}
+
+int main(int argc, char **argv)
+{
+        static const size_t num_threads[] = {1, 4, 16};
+        struct autoptr_pool *pool         = autoptr_pool_get(sizeof(struct obj));
+
+        bench_header();
+        for (size_t n = 0; n < sizeof(num_threads) / sizeof(num_threads[0]); ++n) {
+                const size_t ops = num_threads[n] * NUM_ITER * NUM_LIVE;
+
+                bench_report("alloc_free_calloc", num_threads[n], ops,
+                             bench_run_threads(num_threads[n], churn_calloc, NULL));
+                bench_report("alloc_free_pool", num_threads[n], ops,
+                             bench_run_threads(num_threads[n], churn_pool, pool));
+        }
+
+        return 0;
+}
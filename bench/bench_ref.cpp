@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "bench_common.h"
+#include <libautoptr/autoptr.hpp>
+
+#define NUM_ELEMS 1000
+#define NUM_ROUNDS 200
+
+struct node {
+        struct autoptr autoptr;
+        long value;
+
+        node(long v = 0) : value(v) {}
+};
+
+template <typename P> static long sum(const std::vector<P> &v)
+{
+        long s = 0;
+        for (const P &p : v)
+                s += p->value;
+        return s;
+}
+
+static volatile long sink;
+
+/*
+ * Copy-heavy: every round copies the whole container (one bind/unbind per element)
+ */
+template <typename P> static void run_copy(const char *name, const std::vector<P> &src)
+{
+        const double start = bench_now_ns();
+        for (size_t n = 0; n < NUM_ROUNDS; ++n) {
+                std::vector<P> copy = src;
+                sink                = sink + sum(copy);
+        }
+        bench_report(name, 1, (size_t)NUM_ROUNDS * src.size(), bench_now_ns() - start);
+}
+
+/*
+ * Move-heavy: every round rotates and reverses the container, which only moves and swaps references
+ */
+template <typename P> static void run_move(const char *name, std::vector<P> v)
+{
+        const double start = bench_now_ns();
+        for (size_t n = 0; n < NUM_ROUNDS; ++n) {
+                std::rotate(v.begin(), v.begin() + 1, v.end());
+                std::reverse(v.begin(), v.end());
+        }
+        sink = sink + sum(v);
+        bench_report(name, 1, (size_t)NUM_ROUNDS * v.size(), bench_now_ns() - start);
+}
+
+/*
+ * Allocation: make_ref/make_shared of one element, then dropping it
+ */
+template <typename P, typename F> static void run_make(const char *name, F make)
+{
+        const size_t num_iter = (size_t)NUM_ROUNDS * NUM_ELEMS;
+
+        const double start = bench_now_ns();
+        for (size_t n = 0; n < num_iter; ++n) {
+                P p  = make((long)n);
+                sink = sink + p->value;
+        }
+        bench_report(name, 1, num_iter, bench_now_ns() - start);
+}
+
+int main(int argc, char **argv)
+{
+        std::vector<autoptr::ref<node>> refs;
+        std::vector<std::shared_ptr<node>> shared;
+
+        for (long n = 0; n < NUM_ELEMS; ++n) {
+                refs.push_back(autoptr::make_ref<node>(n));
+                shared.push_back(std::make_shared<node>(n));
+        }
+
+        bench_header();
+        run_copy("ref_copy", refs);
+        run_copy("shared_ptr_copy", shared);
+        run_move("ref_move", refs);
+        run_move("shared_ptr_move", shared);
+        run_make<autoptr::ref<node>>("ref_make", [](long v) { return autoptr::make_ref<node>(v); });
+        run_make<std::shared_ptr<node>>("shared_ptr_make", [](long v) { return std::make_shared<node>(v); });
+
+        return 0;
+}
@@ -0,0 +1,168 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "bench_common.h"
+#include <libautoptr/autoptr.h>
+#include <libautoptr/autoptr_epoch.h>
+#include <libautoptr/autoptr_slot.h>
+
+#define NUM_ITER 200000
+#define WRITE_INTERVAL_NS 100000 // One publication every 100 us
+
+#if AUTOPTR_THREAD_SAFE
+
+struct obj {
+        struct autoptr __autoptr;
+        size_t version;
+};
+
+static void obj_dtor(struct obj *o)
+{
+        if (!autoptr_destroy_ok(o)) {
+                autoptr_release(o);
+                return;
+        }
+        autoptr_dtor(o);
+}
+
+static struct obj *obj_alloc(size_t version)
+{
+        struct obj *o = calloc(1, sizeof(*o));
+        autoptr_ctor(o, sizeof(*o), (void (*)(void *))obj_dtor);
+        autoptr_set_allocd(o, true);
+        o->version = version;
+        return o;
+}
+
+// Baseline: the object pointer is published under an external lock
+static pthread_mutex_t locked_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct obj *locked_ptr       = NULL;
+
+static struct autoptr_slot slot;
+static bool writer_done = false;
+
+static void *read_locked(void *arg)
+{
+        for (size_t n = 0; n < NUM_ITER; ++n) {
+                pthread_mutex_lock(&locked_mutex);
+                struct obj *o = autoptr_bind(locked_ptr);
+                pthread_mutex_unlock(&locked_mutex);
+
+                assert(o->version > 0);
+                autoptr_unbind((void **)&o);
+        }
+        return NULL;
+}
+
+static void *read_slot(void *arg)
+{
+        for (size_t n = 0; n < NUM_ITER; ++n) {
+                struct obj *o = autoptr_slot_load(&slot);
+
+                assert(o->version > 0);
+                autoptr_unbind((void **)&o);
+        }
+        return NULL;
+}
+
+static void *read_epoch(void *arg)
+{
+        for (size_t n = 0; n < NUM_ITER; ++n) {
+                autoptr_epoch_enter();
+                const struct obj *o = autoptr_epoch_borrow(&slot.ptr);
+
+                assert(o->version > 0);
+                autoptr_epoch_exit();
+        }
+        return NULL;
+}
+
+static void pause_ns(long ns)
+{
+        struct timespec ts = {0, ns};
+        nanosleep(&ts, NULL);
+}
+
+static void *write_locked(void *arg)
+{
+        for (size_t version = 2; !__atomic_load_n(&writer_done, __ATOMIC_ACQUIRE); ++version) {
+                struct obj *o = obj_alloc(version);
+
+                pthread_mutex_lock(&locked_mutex);
+                struct obj *old = locked_ptr;
+                locked_ptr      = o;
+                pthread_mutex_unlock(&locked_mutex);
+
+                autoptr_unbind((void **)&old);
+                pause_ns(WRITE_INTERVAL_NS);
+        }
+        return NULL;
+}
+
+static void *write_slot(void *arg)
+{
+        for (size_t version = 2; !__atomic_load_n(&writer_done, __ATOMIC_ACQUIRE); ++version) {
+                struct obj *o = obj_alloc(version);
+
+                autoptr_slot_store(&slot, o);
+                autoptr_free_obj((void **)&o);
+                pause_ns(WRITE_INTERVAL_NS);
+        }
+        return NULL;
+}
+
+/*
+ * Runs num_readers readers against one writer and reports the time per load
+ */
+static void run(const char *name, size_t num_readers, void *(*read)(void *), void *(*write)(void *))
+{
+        pthread_t writer;
+
+        __atomic_store_n(&writer_done, false, __ATOMIC_RELAXED);
+        pthread_create(&writer, NULL, write, NULL);
+
+        const double elapsed = bench_run_threads(num_readers, read, NULL);
+
+        __atomic_store_n(&writer_done, true, __ATOMIC_RELEASE);
+        pthread_join(writer, NULL);
+
+        bench_report(name, num_readers, num_readers * NUM_ITER, elapsed);
+}
+
+int main(int argc, char **argv)
+{
+        static const size_t num_threads[] = {1, 4, 16};
+
+        locked_ptr = obj_alloc(1);
+        autoptr_slot_init(&slot, NULL);
+        autoptr_slot_store(&slot, locked_ptr);
+
+        bench_header();
+        for (size_t n = 0; n < sizeof(num_threads) / sizeof(num_threads[0]); ++n) {
+                run("slot_load_locked", num_threads[n], read_locked, write_locked);
+                run("slot_load", num_threads[n], read_slot, write_slot);
+        }
+
+        // Displaced objects are destroyed once the borrowing readers left their epoch
+        autoptr_epoch_start();
+        for (size_t n = 0; n < sizeof(num_threads) / sizeof(num_threads[0]); ++n)
+                run("slot_borrow", num_threads[n], read_epoch, write_slot);
+        autoptr_epoch_stop();
+
+        autoptr_slot_destroy(&slot);
+        autoptr_free_obj((void **)&locked_ptr);
+
+        return 0;
+}
+
+#else
+
+int main(int argc, char **argv)
+{
+        bench_header(); // Objects may not be shared between threads in this build
+        return 0;
+}
+
+#endif
@@ -31,25 +31,97 @@
 
 #include <assert.h>
 #include <pthread.h>
+#include <sched.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <libautoptr/autoptr_config.h>
+
+#if AUTOPTR_ATOMIC && defined(__cplusplus)
+/*
+ * C++ has no _Atomic qualifier. The atomic fields are declared with their plain types, which have the same size
+ * and alignment; the inline functions below access them through the GCC __atomic builtins in either language.
+ */
+#define __autoptr_atomic(T) T
+#elif AUTOPTR_ATOMIC
+#include <stdatomic.h>
+#define __autoptr_atomic(T) _Atomic(T)
+#endif
+#if AUTOPTR_COMPACT
+#include <stdint.h>
+#endif
+#if AUTOPTR_TRACE
+#include <libautoptr/autoptr_trace.h>
+#endif
+
+#ifdef __cplusplus
+// C++ only members of struct autoptr; they let C++ callers write autoptr::ref<T> (see autoptr.hpp)
+#define __AUTOPTR_CXX_MEMBERS                                                                                     \
+        template <typename T> class ref;                                                                          \
+        template <typename T, typename... Args> static ref<T> make_ref(Args &&...args);                           \
+        template <typename T> static ref<T> make_ref_array(size_t num_managed);
+#else
+#define __AUTOPTR_CXX_MEMBERS
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/// Weak references (see @c autoptr_weak.h) need the full header and a single reference count
+#define AUTOPTR_WEAK (!AUTOPTR_COMPACT && !AUTOPTR_BIASED)
+#define AUTOPTR_EXPIRED (-1) ///< Reference count of a destroyed managed set that still has weak references
+
 #define AUTOPTR_MAGIC 0x643B2B47 ///< cksum (32-bit) CRC of "AUTOPTR_MAGIC"
 #define AUTOPTR(a)                                                                                                \
         ((struct autoptr *)(a)) ///< Macro used for casting the object pointer to @c autoptr (internal usage)
-#define AUTOPTR_LOCK(a) (pthread_mutex_lock(&AUTOPTR(a)->mutex))
-#define AUTOPTR_UNLOCK(a) (pthread_mutex_unlock(&AUTOPTR(a)->mutex))
-
 #define AUTOPTR_M(a) (AUTOPTR(a)->manager)
-#define AUTOPTR_M_LOCK(a) (pthread_mutex_lock(&AUTOPTR_M(a)->mutex))
-#define AUTOPTR_M_UNLOCK(a) (pthread_mutex_unlock(&AUTOPTR_M(a)->mutex))
+
+/**
+ * @brief Allocator of heap-allocated managed sets
+ *
+ * The storage of a managed set flagged with @c autoptr_set_allocator (or
+ * allocated by @c autoptr_alloc_with and @c autoptr_valloc_with) is given back
+ * with @c free of its allocator instead of the system @c free(). The allocator
+ * must outlive the managed sets it allocated.
+ */
+struct autoptr_allocator {
+        void *(*alloc)(size_t len, void *ctx);          ///< Allocates @c len bytes; returns @c NULL on failure
+        void (*free)(void *ptr, size_t len, void *ctx); ///< Frees an allocation of @c len bytes
+        void *ctx;                                      ///< Context passed to @c alloc and @c free
+};
+
+/// The object header carries a lock (see @c AUTOPTR_LOCKING); the compact header has none
+#define AUTOPTR_HEADER_LOCK (!AUTOPTR_COMPACT && AUTOPTR_LOCKING != AUTOPTR_LOCKING_NONE)
+/// Objects may be shared between threads: their counts are atomic or guarded by the header lock
+#define AUTOPTR_THREAD_SAFE (AUTOPTR_ATOMIC || AUTOPTR_HEADER_LOCK)
+
+#if AUTOPTR_HEADER_LOCK
+#define AUTOPTR_LOCK(a) (__autoptr_lock(AUTOPTR(a)))
+#define AUTOPTR_UNLOCK(a) (__autoptr_unlock(AUTOPTR(a)))
+
+#define AUTOPTR_M_LOCK(a) (__autoptr_lock(AUTOPTR_M(a)))
+#define AUTOPTR_M_UNLOCK(a) (__autoptr_unlock(AUTOPTR_M(a)))
+#else
+#define AUTOPTR_LOCK(a)
+#define AUTOPTR_UNLOCK(a)
+#define AUTOPTR_M_LOCK(a)
+#define AUTOPTR_M_UNLOCK(a)
+#endif
 
 #ifdef AUTOPTR_ASSERT
+#if AUTOPTR_COMPACT
+#define autoptr_assert(ptr)                                                                                       \
+        {                                                                                                         \
+                assert(ptr);                                                                                      \
+                const struct autoptr *__manager = ((struct autoptr *)(ptr))->manager;                             \
+                if (__manager == NULL || __manager->manager != __manager) {                                       \
+                        fprintf(stderr, "autoptr_assert_manager: invalid manager %p\n", (void *)__manager);        \
+                        exit(EXIT_FAILURE);                                                                       \
+                }                                                                                                 \
+        }
+#else
 #define autoptr_assert(ptr)                                                                                       \
         {                                                                                                         \
                 AUTOPTR_LOCK(ptr);                                                                                \
@@ -62,11 +134,81 @@ extern "C" {
                 }                                                                                                 \
                 AUTOPTR_UNLOCK(ptr);                                                                              \
         }
+#endif
 
 #else
 #define autoptr_assert(ptr)
 #endif
 
+#if AUTOPTR_COMPACT
+
+#define AUTOPTR_F_ALLOCD 0x1 ///< Compact header flag: the managed set is heap-allocated
+#define AUTOPTR_F_VECTOR 0x2 ///< Compact header flag: the set has more than one object (see @c autoptr_set_managed)
+#define AUTOPTR_F_POOLED 0x4 ///< Compact header flag: the heap allocation belongs to an @c autoptr_pool
+#define AUTOPTR_F_REGION 0x8 ///< Compact header flag: the storage belongs to an @c autoptr_region
+#define AUTOPTR_F_INDEPENDENT 0x10 ///< Compact header flag: the object destructors may run in any order
+#define AUTOPTR_F_TRIVIAL 0x20 ///< Compact header flag: the objects need no destructor call
+#define AUTOPTR_F_ALIGNED 0x40 ///< Compact header flag: the heap allocation comes from @c autoptr_aligned_alloc
+
+#define AUTOPTR_MAX_TYPES 0xFFFF ///< Maximum number of distinct (length, destructor) pairs in compact mode
+
+/**
+ * @brief Per-type metadata of the compact header
+ *
+ * In compact mode the object length and destructor are not stored in each
+ * object. Every distinct pair passed to @c autoptr_ctor or @c autoptr_set_obj
+ * is registered once in a process-wide table and the object stores only its
+ * 16-bit index.
+ */
+struct autoptr_type {
+        size_t obj_len;                            ///< Length in bytes of managed object
+        void (*obj_dtor)(void *);                  ///< Destructor for the managed object
+        void (*obj_vdtor)(void *, size_t);         ///< Destructor for all objects of a managed set, if any
+        const struct autoptr_allocator *allocator; ///< Allocator of heap-allocated sets, if not the system one
+};
+
+extern struct autoptr_type autoptr_types[AUTOPTR_MAX_TYPES]; ///< Type table (internal usage)
+
+/**
+ * @brief Autoptr memory management data structure (compact layout)
+ *
+ * Keeps only what each element of a managed set needs: the manager pointer
+ * and, in the manager, the atomic reference count, the type index and the
+ * flags. The object length and destructor live in the type table. For a
+ * managed set of more than one object the number of managed objects is
+ * stored in the (otherwise unused) count field of the second element.
+ *
+ * The header is guaranteed to be at most 16 bytes (two pointers on LP64).
+ * There is no mutex: reference counts are atomic and the remaining fields are
+ * only written while the object is being constructed or destroyed.
+ */
+#ifdef __cplusplus
+} // Member templates cannot have C linkage
+#endif
+struct autoptr {
+        struct autoptr *manager; ///< Manager object of a managed contiguous set (e.g. 1st in vector of objects)
+        union {
+                struct {
+                        __autoptr_atomic(int) r_count; ///< Reference count
+                        uint16_t type;      ///< Index into the type table
+                        uint16_t flags;     ///< @c AUTOPTR_F_* flags
+                };
+                size_t num_managed; ///< Number of objects of a managed contiguous set (2nd element only)
+        };
+        __AUTOPTR_CXX_MEMBERS
+};
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef __cplusplus
+static_assert(sizeof(struct autoptr) <= 16, "compact autoptr header exceeds 16 bytes");
+#else
+_Static_assert(sizeof(struct autoptr) <= 16, "compact autoptr header exceeds 16 bytes");
+#endif
+
+#else
+
 /**
  * @brief Autoptr memory management data structure.
  *
@@ -78,18 +220,493 @@ extern "C" {
  *
  * For more information see the documentation in @c autoptr.h.
  *
+ * When built with @c AUTOPTR_ATOMIC the reference count is a C11 atomic and
+ * is retained, released and tested without taking the manager mutex.
+ *
+ * When built with @c AUTOPTR_BIASED the count is split between a plain count
+ * updated only by the thread that constructed the object (the owner) and an
+ * atomic shared count used by every other thread (see @c autoptr_biased_merge).
+ *
+ * When built with @c AUTOPTR_SHARDED a managed set may be marked hot, after
+ * which retains and releases go to per-thread shards of the count until it is
+ * drained (see @c autoptr_set_sharded).
+ *
+ * The manager also counts the weak references to the managed set (see
+ * @c autoptr_weak.h). Once a set with weak references is destroyed its
+ * reference count holds @c AUTOPTR_EXPIRED and its header is kept until the
+ * last weak reference is unbound.
+ *
  */
+#ifdef __cplusplus
+} // Member templates cannot have C linkage
+#endif
 struct autoptr {
         unsigned int __magic; ///< Magic number
-        int r_count;          ///< Reference count
-        pthread_mutex_t mutex;
-        size_t obj_len;           ///< Length in bytes of managed object
-        void (*obj_dtor)(void *); ///< Destructor for the managed object
-        struct autoptr *manager;  ///< Manager object of a managed contiguous set (e.g. 1st in vector of objects)
-        size_t num_managed;       ///< Number of objects of a managed contiguous set
-        bool allocd;              ///< Allocation flag; indicates if an object is heap-allocated
+#if AUTOPTR_BIASED
+        __autoptr_atomic(int) r_count; ///< Shared count, in units of @c AUTOPTR_BRC_ONE, and @c AUTOPTR_BRC_* flags
+#elif AUTOPTR_ATOMIC
+        __autoptr_atomic(int) r_count; ///< Reference count
+#else
+        int r_count; ///< Reference count
+#endif
+        const struct autoptr_allocator *allocator; ///< Allocator of the heap allocation, if not the system one
+#if AUTOPTR_LOCKING == AUTOPTR_LOCKING_MUTEX
+        pthread_mutex_t mutex; ///< Guards the count and the fields below
+#elif AUTOPTR_LOCKING == AUTOPTR_LOCKING_SPIN
+        int spin; ///< Spinlock guarding the count and the fields below; 1 while held
+#endif
+        size_t obj_len;                    ///< Length in bytes of managed object
+        void (*obj_dtor)(void *);          ///< Destructor for the managed object
+        void (*obj_vdtor)(void *, size_t); ///< Destructor for all objects of a managed set, if any
+        struct autoptr *manager;           ///< Manager object of a managed contiguous set (e.g. 1st in a vector)
+        size_t num_managed;                ///< Number of objects of a managed contiguous set
+        bool allocd;                       ///< Allocation flag; indicates if an object is heap-allocated
+        bool pooled;                       ///< Pool flag; the heap allocation belongs to an @c autoptr_pool
+        bool regional;                     ///< Region flag; the storage belongs to an @c autoptr_region
+        bool aligned;                      ///< Aligned flag; the heap allocation comes from @c autoptr_aligned_alloc
+        bool independent;                  ///< Independent flag; the object destructors may run in any order
+        bool trivial;                      ///< Trivial flag; the objects need no destructor call
+#if AUTOPTR_WEAK && AUTOPTR_ATOMIC
+        __autoptr_atomic(int) w_count; ///< Weak reference count, plus one until the managed set is destroyed
+#elif AUTOPTR_WEAK
+        int w_count; ///< Weak reference count, plus one until the managed set is destroyed
+#endif
+#if AUTOPTR_BIASED
+        int brc_local;                                          ///< Owner-local reference count
+        __autoptr_atomic(struct autoptr_brc_owner *) brc_owner; ///< Owner thread; @c NULL once the counts are merged
+        struct autoptr *brc_next;                               ///< Link in the merge queue of the owner thread
+#endif
+#if AUTOPTR_SHARDED
+        __autoptr_atomic(struct autoptr_shard *) shards; ///< Count shards of a hot managed set; @c NULL if not sharded
+#endif
+        __AUTOPTR_CXX_MEMBERS
+};
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if AUTOPTR_LOCKING == AUTOPTR_LOCKING_SPIN
+
+#define AUTOPTR_SPIN_LIMIT 64 ///< Number of busy waits for a held spinlock before yielding the processor
+
+#if defined(__x86_64__) || defined(__i386__)
+#define __autoptr_cpu_relax() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define __autoptr_cpu_relax() __asm__ __volatile__("yield")
+#else
+#define __autoptr_cpu_relax()
+#endif
+
+/*
+ * Test-and-test-and-set: waiters spin on a plain load so that the cache line stays shared until the lock is
+ * released, and yield once the holder seems to have been preempted
+ */
+static inline void __autoptr_lock(struct autoptr *a)
+{
+        while (__atomic_exchange_n(&a->spin, 1, __ATOMIC_ACQUIRE)) {
+                for (unsigned int n = 0; __atomic_load_n(&a->spin, __ATOMIC_RELAXED); ++n) {
+                        if (n < AUTOPTR_SPIN_LIMIT)
+                                __autoptr_cpu_relax();
+                        else
+                                sched_yield();
+                }
+        }
+}
+
+static inline void __autoptr_unlock(struct autoptr *a)
+{
+        __atomic_store_n(&a->spin, 0, __ATOMIC_RELEASE);
+}
+
+#elif AUTOPTR_LOCKING == AUTOPTR_LOCKING_MUTEX
+
+static inline void __autoptr_lock(struct autoptr *a)
+{
+        pthread_mutex_lock(&a->mutex);
+}
+
+static inline void __autoptr_unlock(struct autoptr *a)
+{
+        pthread_mutex_unlock(&a->mutex);
+}
+
+#endif
+
+#endif // AUTOPTR_COMPACT
+
+#if AUTOPTR_SHARDED
+
+#define AUTOPTR_NUM_SHARDS 32          ///< Number of count shards of a sharded managed set (power of two)
+#define AUTOPTR_SHARD_CLOSED 0x1       ///< Shard flag: the shard was drained into the reference count
+#define AUTOPTR_SHARD_PIN (1 << 24)    ///< References held by the shards on the reference count until drained
+
+/**
+ * @brief Reference count shard (internal usage)
+ *
+ * Holds twice the number of references retained less those released through
+ * the shard, plus @c AUTOPTR_SHARD_CLOSED once drained. Each shard has a cache
+ * line of its own.
+ */
+struct autoptr_shard {
+        __autoptr_atomic(long) count; ///< Twice the reference delta of the shard, and @c AUTOPTR_SHARD_CLOSED
+        char __pad[64 - sizeof(long)];
+} __attribute__((aligned(64)));
+
+/// Shard index of the calling thread plus one; 0 until it first uses a shard
+extern __thread unsigned int __autoptr_shard_self __attribute__((tls_model("initial-exec")));
+
+unsigned int __autoptr_shard_register(void);
+void __autoptr_shard_drain(struct autoptr *manager);
+int __autoptr_shard_references(struct autoptr *manager);
+
+/*
+ * Adds n references through the shard of the calling thread. Returns false if the set is not sharded or was
+ * drained, in which case the caller updates the reference count instead.
+ */
+static inline bool __autoptr_shard_add(struct autoptr *manager, int n, int order)
+{
+        struct autoptr_shard *shards = __atomic_load_n(&manager->shards, __ATOMIC_ACQUIRE);
+        if (shards == NULL)
+                return false;
+
+        unsigned int self = __autoptr_shard_self;
+        if (self == 0)
+                self = __autoptr_shard_register();
+
+        const long count = __atomic_fetch_add(&shards[(self - 1) & (AUTOPTR_NUM_SHARDS - 1)].count, 2L * n, order);
+        return !(count & AUTOPTR_SHARD_CLOSED);
+}
+
+/*
+ * Tests if the set is sharded and not yet drained
+ */
+static inline bool __autoptr_sharded(struct autoptr *manager)
+{
+        struct autoptr_shard *shards = __atomic_load_n(&manager->shards, __ATOMIC_ACQUIRE);
+        return shards != NULL && !(__atomic_load_n(&shards[0].count, __ATOMIC_RELAXED) & AUTOPTR_SHARD_CLOSED);
+}
+
+#endif // AUTOPTR_SHARDED
+
+#if AUTOPTR_BIASED
+
+#define AUTOPTR_BRC_MERGED 0x1 ///< Shared count flag: the local count was merged; all threads use the shared count
+#define AUTOPTR_BRC_QUEUED 0x2 ///< Shared count flag: the object was queued to its owner thread for merging
+#define AUTOPTR_BRC_ONE 0x4    ///< One reference in the shared count
+
+/**
+ * @brief Biased reference counting record of an owner thread (internal usage)
+ *
+ * Holds the queue of objects that other threads released below their shared
+ * count and whose counts the owner thread has to merge.
+ */
+struct autoptr_brc_owner {
+        __autoptr_atomic(struct autoptr *) queue; ///< Objects to merge (linked through @c brc_next)
+        __autoptr_atomic(bool) exited;            ///< The thread has exited; other threads merge on its behalf
 };
 
+/// Record of the calling thread; @c NULL until it constructs an object
+extern __thread struct autoptr_brc_owner *__autoptr_brc_self __attribute__((tls_model("initial-exec")));
+
+void __autoptr_brc_drop(struct autoptr *manager);
+void __autoptr_brc_queue(struct autoptr *manager);
+void __autoptr_brc_drain(struct autoptr_brc_owner *owner);
+
+static inline int __autoptr_brc_count(int shared)
+{
+        return (shared & ~(AUTOPTR_BRC_ONE - 1)) / AUTOPTR_BRC_ONE;
+}
+
+static inline bool __autoptr_brc_owned(struct autoptr *manager)
+{
+        struct autoptr_brc_owner *self = __autoptr_brc_self;
+        return self != NULL && __atomic_load_n(&manager->brc_owner, __ATOMIC_RELAXED) == self;
+}
+
+/*
+ * Only the owner thread writes the local count, so relaxed loads and stores (plain moves) suffice; other threads
+ * only read it to report the number of references.
+ */
+static inline void __autoptr_brc_local_add(struct autoptr *manager, int n)
+{
+        __atomic_store_n(&manager->brc_local, __atomic_load_n(&manager->brc_local, __ATOMIC_RELAXED) + n,
+                         __ATOMIC_RELAXED);
+}
+
+static inline void __autoptr_brc_retain(struct autoptr *manager, int n)
+{
+        if (__autoptr_brc_owned(manager))
+                __autoptr_brc_local_add(manager, n);
+        else
+                __atomic_fetch_add(&manager->r_count, n * AUTOPTR_BRC_ONE, __ATOMIC_RELAXED);
+}
+
+/*
+ * Releases n references through the shared count and returns the new shared count. A thread that drives the count
+ * of an unmerged object negative releases references counted by the owner; it flags the object as queued in the
+ * same update (so that the owner does not destroy it meanwhile) and pushes it to the owner for merging.
+ */
+static inline int __autoptr_brc_shared_release(struct autoptr *manager, int n, int order)
+{
+        int shared = __atomic_load_n(&manager->r_count, __ATOMIC_RELAXED);
+        int next;
+
+        do {
+                next = shared - n * AUTOPTR_BRC_ONE;
+                if (!(shared & (AUTOPTR_BRC_MERGED | AUTOPTR_BRC_QUEUED)) && __autoptr_brc_count(next) < 0)
+                        next |= AUTOPTR_BRC_QUEUED;
+        } while (!__atomic_compare_exchange_n(&manager->r_count, &shared, next, true, order, __ATOMIC_RELAXED));
+
+        if ((next & AUTOPTR_BRC_QUEUED) && !(shared & AUTOPTR_BRC_QUEUED))
+                __autoptr_brc_queue(manager);
+
+        return next;
+}
+
+static inline void __autoptr_brc_release(struct autoptr *manager, int n)
+{
+        if (__autoptr_brc_owned(manager)) {
+                __autoptr_brc_local_add(manager, -n);
+
+                // The owner dropped all of its local references
+                if (__atomic_load_n(&manager->brc_local, __ATOMIC_RELAXED) <= 0)
+                        __autoptr_brc_drop(manager);
+        } else {
+                __attribute__((unused)) const int shared = __autoptr_brc_shared_release(manager, n, __ATOMIC_RELEASE);
+                assert(!(shared & AUTOPTR_BRC_MERGED) || __autoptr_brc_count(shared) >= 1);
+        }
+
+        struct autoptr_brc_owner *self = __autoptr_brc_self;
+        if (self != NULL && __atomic_load_n(&self->queue, __ATOMIC_RELAXED) != NULL)
+                __autoptr_brc_drain(self);
+}
+
+/*
+ * Number of ownerships (bound references plus the creator) of the object
+ */
+static inline int __autoptr_brc_ownerships(struct autoptr *manager, int order)
+{
+        return __atomic_load_n(&manager->brc_local, __ATOMIC_RELAXED) +
+               __autoptr_brc_count(__atomic_load_n(&manager->r_count, order));
+}
+
+static inline bool __autoptr_brc_destroy_ok(struct autoptr *manager)
+{
+        // The owner reads its own local count, so its sum is exact. A queued object is merged (and destroyed once
+        // unreferenced) through the queue of the owner.
+        if (__autoptr_brc_owned(manager)) {
+                const int shared = __atomic_load_n(&manager->r_count, __ATOMIC_ACQUIRE);
+                return !(shared & AUTOPTR_BRC_QUEUED) &&
+                       __atomic_load_n(&manager->brc_local, __ATOMIC_RELAXED) + __autoptr_brc_count(shared) == 1;
+        }
+
+        // Other threads decide only once the counts are merged
+        const int shared = __atomic_load_n(&manager->r_count, __ATOMIC_ACQUIRE);
+        return (shared & AUTOPTR_BRC_MERGED) && __autoptr_brc_count(shared) == 1;
+}
+
+#endif // AUTOPTR_BIASED
+
+/**
+ * @brief Length in bytes of the objects of a managed set (internal usage)
+ *
+ * @param manager Manager of the managed set
+ */
+static inline size_t __autoptr_obj_len(const struct autoptr *manager)
+{
+#if AUTOPTR_COMPACT
+        return autoptr_types[manager->type].obj_len;
+#else
+        return manager->obj_len;
+#endif
+}
+
+/**
+ * @brief Destructor of the objects of a managed set (internal usage)
+ *
+ * @param manager Manager of the managed set
+ */
+static inline void (*__autoptr_obj_dtor(const struct autoptr *manager))(void *)
+{
+#if AUTOPTR_COMPACT
+        return autoptr_types[manager->type].obj_dtor;
+#else
+        return manager->obj_dtor;
+#endif
+}
+
+/**
+ * @brief Vector destructor of a managed set (internal usage)
+ *
+ * @param manager Manager of the managed set
+ */
+static inline void (*__autoptr_obj_vdtor(const struct autoptr *manager))(void *, size_t)
+{
+#if AUTOPTR_COMPACT
+        return autoptr_types[manager->type].obj_vdtor;
+#else
+        return manager->obj_vdtor;
+#endif
+}
+
+/**
+ * @brief Allocator of a managed set (internal usage)
+ *
+ * @param manager Manager of the managed set
+ */
+static inline const struct autoptr_allocator *__autoptr_allocator(const struct autoptr *manager)
+{
+#if AUTOPTR_COMPACT
+        return autoptr_types[manager->type].allocator;
+#else
+        return manager->allocator;
+#endif
+}
+
+/**
+ * @brief Number of objects of a managed set, read without locking (internal usage)
+ *
+ * @param manager Manager of the managed set
+ */
+static inline size_t __autoptr_num_managed(const struct autoptr *manager)
+{
+#if AUTOPTR_COMPACT
+        if (!(manager->flags & AUTOPTR_F_VECTOR))
+                return 1;
+        return AUTOPTR((char *)manager + __autoptr_obj_len(manager))->num_managed;
+#else
+        return manager->num_managed;
+#endif
+}
+
+/**
+ * @brief Pool flag of a managed set, read without locking (internal usage)
+ *
+ * @param manager Manager of the managed set
+ */
+static inline bool __autoptr_pooled(const struct autoptr *manager)
+{
+#if AUTOPTR_COMPACT
+        return manager->flags & AUTOPTR_F_POOLED;
+#else
+        return manager->pooled;
+#endif
+}
+
+/**
+ * @brief Aligned flag of a managed set, read without locking (internal usage)
+ *
+ * @param manager Manager of the managed set
+ */
+static inline bool __autoptr_aligned(const struct autoptr *manager)
+{
+#if AUTOPTR_COMPACT
+        return manager->flags & AUTOPTR_F_ALIGNED;
+#else
+        return manager->aligned;
+#endif
+}
+
+/**
+ * @brief Region flag of a managed set, read without locking (internal usage)
+ *
+ * @param manager Manager of the managed set
+ */
+static inline bool __autoptr_regional(const struct autoptr *manager)
+{
+#if AUTOPTR_COMPACT
+        return manager->flags & AUTOPTR_F_REGION;
+#else
+        return manager->regional;
+#endif
+}
+
+/**
+ * @brief Independent flag of a managed set, read without locking (internal usage)
+ *
+ * @param manager Manager of the managed set
+ */
+static inline bool __autoptr_independent(const struct autoptr *manager)
+{
+#if AUTOPTR_COMPACT
+        return manager->flags & AUTOPTR_F_INDEPENDENT;
+#else
+        return manager->independent;
+#endif
+}
+
+/**
+ * @brief Trivial flag of a managed set, read without locking (internal usage)
+ *
+ * @param manager Manager of the managed set
+ */
+static inline bool __autoptr_trivial(const struct autoptr *manager)
+{
+#if AUTOPTR_COMPACT
+        return manager->flags & AUTOPTR_F_TRIVIAL;
+#else
+        return manager->trivial;
+#endif
+}
+
+/**
+ * @brief Heap allocation flag of a managed set, read without locking (internal usage)
+ *
+ * @param manager Manager of the managed set
+ */
+static inline bool __autoptr_allocd(const struct autoptr *manager)
+{
+#if AUTOPTR_COMPACT
+        return manager->flags & AUTOPTR_F_ALLOCD;
+#else
+        return manager->allocd;
+#endif
+}
+
+#if AUTOPTR_STATS
+// Statistics events (internal usage; see autoptr_stats.h)
+#define AUTOPTR_STATS_CTOR 0
+#define AUTOPTR_STATS_DTOR 1
+#define AUTOPTR_STATS_BIND 2
+#define AUTOPTR_STATS_UNBIND 3
+
+/**
+ * @brief Counts @c n statistics events of the type of a managed set on the calling thread (internal usage)
+ *
+ * @param manager Manager of the managed set
+ * @param event One of the @c AUTOPTR_STATS_* events
+ * @param n Number of events
+ */
+void __autoptr_stats_count(const struct autoptr *manager, int event, long n);
+
+#define AUTOPTR_STATS_COUNT(manager, event, n) __autoptr_stats_count(manager, event, n)
+#else
+#define AUTOPTR_STATS_COUNT(manager, event, n)
+#endif
+
+#if AUTOPTR_TRACE
+/**
+ * @brief Records an event in the trace ring of the calling thread (internal usage)
+ *
+ * Called before the operation, while the caller still holds its reference.
+ *
+ * @param event One of the @c AUTOPTR_TRACE_* events
+ * @param ptr Address of the object
+ * @param manager Manager of its managed set
+ * @param n Number of references bound or released
+ * @param caller Call site of the operation; @c NULL for the return address of this procedure (the call site of
+ * an inline operation)
+ */
+void __autoptr_trace(int event, const void *ptr, struct autoptr *manager, int n, const void *caller);
+
+#define AUTOPTR_TRACE_EVENT(event, ptr, manager, n, caller) __autoptr_trace(event, ptr, manager, n, caller)
+// Traced inline operations are always inlined, so that the return address of __autoptr_trace is their call site
+#define AUTOPTR_TRACE_INLINE __attribute__((always_inline))
+#else
+#define AUTOPTR_TRACE_EVENT(event, ptr, manager, n, caller)
+#define AUTOPTR_TRACE_INLINE
+#endif
+
 /**
  * @brief Constructor for the memory management data structure
  *
@@ -145,24 +762,133 @@ static inline void autoptr_set_managed(void *ptr, size_t num_managed)
         // Assert first object is self-managed
         assert(AUTOPTR(ptr)->manager == AUTOPTR(ptr));
 
+        const size_t obj_len = __autoptr_obj_len(AUTOPTR(ptr));
+
+#if !AUTOPTR_COMPACT
         // Set the number of managed objects for the manager
         AUTOPTR(ptr)->num_managed = num_managed; // Includes self
+#endif
 
         for (size_t i = 1; i < num_managed; ++i) {
-                void *obj = (void *)((char *)ptr + AUTOPTR(ptr)->obj_len * i);
+                void *obj = (void *)((char *)ptr + obj_len * i);
                 autoptr_assert(obj);
 
                 AUTOPTR(obj)->manager     = AUTOPTR(ptr);
                 AUTOPTR(obj)->num_managed = 0;
         }
+
+#if AUTOPTR_COMPACT
+        // The second element carries the number of managed objects for the manager
+        if (num_managed > 1) {
+                AUTOPTR(ptr)->flags |= AUTOPTR_F_VECTOR;
+                AUTOPTR((char *)ptr + obj_len)->num_managed = num_managed; // Includes self
+        }
+#endif
 }
 
+/**
+ * @brief Sets a destructor called once for all objects of a managed set
+ *
+ * When the set is destroyed, @c obj_vdtor is called with the address of the
+ * first object and the number of objects in place of the per-object
+ * destructor calls; the library then tears down the autoptr struct of the
+ * manager itself.
+ * Typically used for element types whose destruction can be vectorized.
+ *
+ * @param ptr Address of memory managed object
+ * @param obj_vdtor Destructor for all objects of the managed set; @c NULL to go back to per-object destructor calls
+ *
+ * @note This procedure is not thread safe.
+ */
+void autoptr_set_vdtor(void *ptr, void (*obj_vdtor)(void *, size_t));
+
+/**
+ * @brief Declares the objects of a managed set trivially destructible
+ *
+ * When the set is destroyed no destructor is called for its objects (the
+ * vector destructor, if any, still is); the autoptr structs are torn down and
+ * the storage freed.
+ *
+ * @param ptr Address of memory managed object
+ *
+ * @note This procedure is not thread safe.
+ */
+void autoptr_set_trivial(void *ptr);
+
+/**
+ * @brief Sets the allocator of a heap-allocated managed set
+ *
+ * Used in place of @c autoptr_set_allocd for a set allocated with
+ * @c allocator->alloc; its last unbind frees it with @c allocator->free.
+ *
+ * @param ptr Address of memory managed object
+ * @param allocator Allocator of the managed set
+ */
+void autoptr_set_allocator(void *ptr, const struct autoptr_allocator *allocator);
+
+/**
+ * @brief Allocates and constructs a heap-allocated object
+ *
+ * Equivalent to allocating the object with @c calloc, then calling
+ * @c autoptr_ctor and @c autoptr_set_allocd, without locking the manager.
+ * The object bytes after the autoptr struct are zeroed.
+ *
+ * @param obj_len Length in bytes of the object
+ * @param obj_dtor Destructor for the object
+ * @return Address of the object, holding the creator's ownership; @c NULL if it could not be allocated
+ */
+void *autoptr_alloc(size_t obj_len, void (*obj_dtor)(void *));
+
+/**
+ * @brief Allocates and constructs a heap-allocated managed vector
+ *
+ * Equivalent to allocating the vector with @c calloc, then calling
+ * @c autoptr_ctor for each object, @c autoptr_set_allocd and
+ * @c autoptr_set_managed, without locking the manager.
+ *
+ * @param obj_len Length in bytes of the objects
+ * @param num_managed Number of objects (at least 1)
+ * @param obj_dtor Destructor for the objects
+ * @return Address of the first object (the manager), holding the creator's ownership; @c NULL if the vector could
+ * not be allocated
+ */
+void *autoptr_valloc(size_t obj_len, size_t num_managed, void (*obj_dtor)(void *));
+
+/**
+ * @brief Allocates and constructs an object with an allocator
+ *
+ * As @c autoptr_alloc, allocating with @c allocator->alloc; the last unbind
+ * frees the object with @c allocator->free.
+ *
+ * @param allocator Allocator; @c NULL for the system allocator
+ * @param obj_len Length in bytes of the object
+ * @param obj_dtor Destructor for the object
+ * @return Address of the object, holding the creator's ownership; @c NULL if it could not be allocated
+ */
+void *autoptr_alloc_with(const struct autoptr_allocator *allocator, size_t obj_len, void (*obj_dtor)(void *));
+
+/**
+ * @brief Allocates and constructs a managed vector with an allocator
+ *
+ * As @c autoptr_valloc, allocating with @c allocator->alloc; the last unbind
+ * frees the vector with @c allocator->free.
+ *
+ * @param allocator Allocator; @c NULL for the system allocator
+ * @param obj_len Length in bytes of the objects
+ * @param num_managed Number of objects (at least 1)
+ * @param obj_dtor Destructor for the objects
+ * @return Address of the first object (the manager), holding the creator's ownership; @c NULL if the vector could
+ * not be allocated
+ */
+void *autoptr_valloc_with(const struct autoptr_allocator *allocator, size_t obj_len, size_t num_managed,
+                          void (*obj_dtor)(void *));
+
 static inline size_t autoptr_num_managed(void *ptr)
 {
         autoptr_assert(ptr);
 
         AUTOPTR_M_LOCK(ptr);
-        size_t num_managed = AUTOPTR_M(ptr)->num_managed;
+        size_t num_managed = __autoptr_num_managed(AUTOPTR_M(ptr));
         AUTOPTR_M_UNLOCK(ptr);
 
         return num_managed;
@@ -172,11 +898,21 @@ static inline int autoptr_num_references(void *ptr)
 {
 	autoptr_assert(ptr);
 
+#if AUTOPTR_BIASED
+        return __autoptr_brc_ownerships(AUTOPTR_M(ptr), __ATOMIC_RELAXED) - 1;
+#elif AUTOPTR_ATOMIC
+#if AUTOPTR_SHARDED
+        if (__autoptr_sharded(AUTOPTR_M(ptr)))
+                return __autoptr_shard_references(AUTOPTR_M(ptr));
+#endif
+        return __atomic_load_n(&AUTOPTR_M(ptr)->r_count, __ATOMIC_RELAXED);
+#else
         AUTOPTR_M_LOCK(ptr);
         int r_count = AUTOPTR_M(ptr)->r_count;
         AUTOPTR_M_UNLOCK(ptr);
 
 	return r_count;
+#endif
 }
 
 /**
@@ -188,11 +924,27 @@ static inline bool autoptr_destroy_ok(void *ptr)
 {
         autoptr_assert(ptr);
 
+#if AUTOPTR_BIASED
+        return __autoptr_brc_destroy_ok(AUTOPTR_M(ptr));
+#elif AUTOPTR_ATOMIC
+#if AUTOPTR_SHARDED
+        // Only the exact count tells; a sharded set is drained first
+        if (__autoptr_sharded(AUTOPTR_M(ptr)))
+                __autoptr_shard_drain(AUTOPTR_M(ptr));
+#endif
+        // Acquire pairs with the release in autoptr_release() so that the destroying thread observes all
+        // writes made by the other owners before they let go of the object. The count is AUTOPTR_EXPIRED while
+        // a set with weak references is destroyed.
+        const int r_count = __atomic_load_n(&AUTOPTR_M(ptr)->r_count, __ATOMIC_ACQUIRE);
+        assert(r_count >= AUTOPTR_EXPIRED);
+        return (r_count <= 0);
+#else
         AUTOPTR_M_LOCK(ptr);
-        assert(AUTOPTR_M(ptr)->r_count >= 0);
-        bool destroy = (AUTOPTR_M(ptr)->r_count == 0);
+        assert(AUTOPTR_M(ptr)->r_count >= AUTOPTR_EXPIRED);
+        bool destroy = (AUTOPTR_M(ptr)->r_count <= 0);
         AUTOPTR_M_UNLOCK(ptr);
         return destroy;
+#endif
 }
 
 /**
@@ -205,7 +957,7 @@ static inline bool autoptr_get_allocd(void *ptr)
         autoptr_assert(ptr);
 
         AUTOPTR_M_LOCK(ptr);
-        bool allocd = AUTOPTR_M(ptr)->allocd;
+        bool allocd = __autoptr_allocd(AUTOPTR_M(ptr));
         AUTOPTR_M_UNLOCK(ptr);
         return allocd;
 }
@@ -219,38 +971,162 @@ static inline void autoptr_set_allocd(void *ptr, bool allocd)
 {
         autoptr_assert(ptr);
         AUTOPTR_M_LOCK(ptr);
+#if AUTOPTR_COMPACT
+        if (allocd)
+                AUTOPTR_M(ptr)->flags |= AUTOPTR_F_ALLOCD;
+        else
+                AUTOPTR_M(ptr)->flags &= ~AUTOPTR_F_ALLOCD;
+#else
         AUTOPTR_M(ptr)->allocd = allocd;
+#endif
         AUTOPTR_M_UNLOCK(ptr);
 }
 
 /**
- * @brief Retains ownership of the object
+ * @brief Retains @c n ownerships of the object at once
+ *
+ * Equivalent to @c n calls to @c autoptr_retain, but updates the manager once.
  *
  * @param ptr Address of memory managed object
+ * @param n Number of ownerships to retain
  */
-static inline void autoptr_retain(void *ptr)
+static inline AUTOPTR_TRACE_INLINE void autoptr_retain_n(void *ptr, int n)
 {
         autoptr_assert(ptr);
+        assert(n >= 0);
+        AUTOPTR_STATS_COUNT(AUTOPTR_M(ptr), AUTOPTR_STATS_BIND, n);
+        AUTOPTR_TRACE_EVENT(AUTOPTR_TRACE_BIND, ptr, AUTOPTR_M(ptr), n, NULL);
 
+#if AUTOPTR_BIASED
+        __autoptr_brc_retain(AUTOPTR_M(ptr), n);
+#elif AUTOPTR_ATOMIC
+#if AUTOPTR_SHARDED
+        if (__autoptr_shard_add(AUTOPTR_M(ptr), n, __ATOMIC_RELAXED))
+                return;
+#endif
+        // A new reference is always made from an existing one, so no ordering is required
+        __atomic_fetch_add(&AUTOPTR_M(ptr)->r_count, n, __ATOMIC_RELAXED);
+#else
         AUTOPTR_M_LOCK(ptr);
-        AUTOPTR_M(ptr)->r_count++;
+        AUTOPTR_M(ptr)->r_count += n;
         AUTOPTR_M_UNLOCK(ptr);
+#endif
 }
 
 /**
- * @brief Releases ownership of the object
+ * @brief Releases @c n ownerships of the object at once
+ *
+ * Equivalent to @c n calls to @c autoptr_release, but updates the manager once.
  *
  * @param ptr Address of the memory management object
+ * @param n Number of ownerships to release
  */
-static inline void autoptr_release(void *ptr)
+static inline AUTOPTR_TRACE_INLINE void autoptr_release_n(void *ptr, int n)
 {
         autoptr_assert(ptr);
+        assert(n >= 0);
+        AUTOPTR_STATS_COUNT(AUTOPTR_M(ptr), AUTOPTR_STATS_UNBIND, n);
+        AUTOPTR_TRACE_EVENT(AUTOPTR_TRACE_RELEASE, ptr, AUTOPTR_M(ptr), n, NULL);
 
+#if AUTOPTR_BIASED
+        __autoptr_brc_release(AUTOPTR_M(ptr), n);
+#else
+        __attribute__((unused)) int r_count;
+#if AUTOPTR_SHARDED
+        if (__autoptr_shard_add(AUTOPTR_M(ptr), -n, __ATOMIC_RELEASE))
+                return;
+#endif
+#if AUTOPTR_ATOMIC
+        r_count = __atomic_fetch_sub(&AUTOPTR_M(ptr)->r_count, n, __ATOMIC_RELEASE) - n;
+#else
         AUTOPTR_M_LOCK(ptr);
-        assert(--AUTOPTR_M(ptr)->r_count >= 0);
+        r_count = (AUTOPTR_M(ptr)->r_count -= n);
         AUTOPTR_M_UNLOCK(ptr);
+#endif
+        assert(r_count >= 0);
+#endif
 }
 
+/**
+ * @brief Retains ownership of the object
+ *
+ * @param ptr Address of memory managed object
+ */
+static inline AUTOPTR_TRACE_INLINE void autoptr_retain(void *ptr)
+{
+        autoptr_retain_n(ptr, 1);
+}
+
+/**
+ * @brief Releases ownership of the object
+ *
+ * @param ptr Address of the memory management object
+ */
+static inline AUTOPTR_TRACE_INLINE void autoptr_release(void *ptr)
+{
+        autoptr_release_n(ptr, 1);
+}
+
+#if AUTOPTR_BIASED
+/**
+ * @brief Merges the owner-local and shared reference counts of an object
+ *
+ * In biased mode the thread that constructed an object counts its references
+ * without atomic operations, and other threads can only tell that they hold
+ * the last reference once the counts are merged. The counts are merged
+ * automatically when the owner thread releases its last local reference, when
+ * another thread releases a reference counted by the owner (the owner merges at
+ * its next release or @c autoptr_biased_drain), and when the owner thread exits.
+ *
+ * The owner calls this procedure to merge eagerly when handing the object off to
+ * other threads for good. It has no effect when called by another thread.
+ *
+ * @param ptr Address of memory managed object
+ */
+void autoptr_biased_merge(void *ptr);
+
+/**
+ * @brief Merges the counts of the objects queued to the calling thread
+ *
+ * Objects whose last reference was released by another thread are destroyed
+ * here (or at the next release on the owner thread).
+ */
+void autoptr_biased_drain(void);
+#endif
+
+#if AUTOPTR_SHARDED
+/**
+ * @brief Marks a managed set as hot, sharding its reference count
+ *
+ * Retains and releases of the objects of the set then go to per-thread
+ * shards of the count, each on a cache line of its own, instead of the single
+ * count of the manager. While sharded, releases never test for the last
+ * reference: the shards hold @c AUTOPTR_SHARD_PIN references on the count until
+ * the set is drained by @c autoptr_unshard, @c autoptr_destroy_ok,
+ * @c autoptr_free_obj or @c autoptr_vfree_obj, i.e. when the creator releases
+ * its ownership. A drained set counts references as usual and cannot be sharded
+ * again.
+ *
+ * A set may hold fewer than @c AUTOPTR_SHARD_PIN references while it is
+ * drained.
+ *
+ * @param ptr Address of memory managed object (of a set whose ownership the caller holds)
+ * @return 0 on success; -1 if the set was already sharded or the shards could not be allocated
+ */
+int autoptr_set_sharded(void *ptr);
+
+/**
+ * @brief Drains the shards of a managed set into its reference count
+ *
+ * Has no effect on sets that are not sharded or were already drained. The
+ * creator calls this before releasing its ownership with @c autoptr_unbind;
+ * @c autoptr_destroy_ok and @c autoptr_free_obj drain implicitly.
+ *
+ * @param ptr Address of memory managed object
+ */
+void autoptr_unshard(void *ptr);
+#endif
+
 /**
  * @brief Binds a reference to an object
  *
@@ -258,7 +1134,7 @@ static inline void autoptr_release(void *ptr)
  * @return Address of memory managed object
  * @note This procedure is similar to @c autoptr_retain, but here returns the address of the managed object
  */
-static inline void *autoptr_bind(void *ptr)
+static inline AUTOPTR_TRACE_INLINE void *autoptr_bind(void *ptr)
 {
         autoptr_retain(ptr);
         return ptr;
@@ -271,6 +1147,53 @@ static inline void *autoptr_bind(void *ptr)
  */
 void autoptr_unbind(void **ptr);
 
+/**
+ * @brief Releases an ownership of the object and tests if it was the last one, in one step
+ *
+ * Replaces the @c autoptr_destroy_ok and @c autoptr_release pair at the top of
+ * an object destructor:
+ *
+ *     if (!autoptr_release_last(my_struct))
+ *             return;
+ *     // Destroy the internal state otherwise
+ *
+ * Exactly one of any number of concurrent callers sees the last ownership go.
+ * The destructors of the objects of a managed set being destroyed see @c true
+ * without touching the count.
+ *
+ * @param ptr Address of memory managed object
+ * @return @c true if the caller held the last ownership of the managed set, which it then destroys (from an object
+ * destructor, by destroying the object; elsewhere with @c autoptr_destroy); @c false if other ownerships remain
+ */
+bool autoptr_release_last(void *ptr);
+
+/**
+ * @brief Destroys a managed set whose last ownership was released with @c autoptr_release_last
+ *
+ * Calls the object destructors and frees the storage of the set, as the last
+ * @c autoptr_unbind does (or queues the set with deferred reclaim).
+ *
+ * @param ptr Address of memory managed object
+ */
+void autoptr_destroy(void *ptr);
+
+/**
+ * @brief Moves a bound reference out of a variable
+ *
+ * Transfers the reference held in @c *ptr to the caller without touching the
+ * reference count, e.g. to store it elsewhere or hand it to another thread;
+ * the variable no longer holds a reference and must not be unbound.
+ *
+ * @param ptr Pointer to bound reference; set to @c NULL
+ * @return The reference, now owned by the caller
+ */
+static inline void *autoptr_move(void **ptr)
+{
+        void *moved = *ptr;
+        *ptr        = NULL;
+        return moved;
+}
+
 /**
  * @brief Binds a list of references to a vector of objects
  *
@@ -278,6 +1201,8 @@ void autoptr_unbind(void **ptr);
  * @param size Size of the vector (i.e. number of objects in the vector)
  * @retval ptr_list List of object references (vector of pointers; of size @c size)
  *
+ * @note Objects of the vector sharing a manager (see @c autoptr_set_managed) are retained with a single
+ * update of the manager.
  */
 void autoptr_vbindl(void *ptr, size_t size, void *ptr_list[]);
 
@@ -298,6 +1223,32 @@ void autoptr_lbindl(void *ptr[], size_t size, void *ptr_list[]);
  */
 void autoptr_lunbind(void *ptr_list[], size_t size);
 
+/**
+ * @brief Binds a list of references to a list of objects, updating each manager once
+ *
+ * Produces the same references as @c autoptr_lbindl, but the references are
+ * grouped by manager (duplicates across the list included) and each manager
+ * is retained once by the number of references to its managed set.
+ *
+ * @param ptr List of managed objects (vector of pointers)
+ * @param size Size of the list (i.e. number of objects in the list)
+ * @retval ptr_list List of object references (vector of pointers)
+ */
+void autoptr_lbindl_batch(void *ptr[], size_t size, void *ptr_list[]);
+
+/**
+ * @brief Unbinds a list of references, updating each manager once
+ *
+ * Has the same effect as @c autoptr_lunbind, but the references are grouped
+ * by manager (duplicates across the list included) and each manager is
+ * released once by the number of references to its managed set. A managed
+ * set whose last references are in the list is destroyed once.
+ *
+ * @param ptr_list List of managed objects (vector of pointers); each entry is set to @c NULL upon returning
+ * @param size Size of the list (i.e. number of objects in the list)
+ */
+void autoptr_lunbind_batch(void *ptr_list[], size_t size);
+
 /**
  * @brief Generic procedure for freeing memory managed objects
  *
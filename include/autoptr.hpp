@@ -0,0 +1,328 @@
+/*
+ * Copyright (c) 2017-2019 Jason Graham <jgraham@compukix.net>
+ *
+ * This file is part of libautoptr.
+ *
+ * libautoptr is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libautoptr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libautoptr.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file
+ * @brief Autoptr C++ Definitions
+ *
+ * Header-only C++ (C++11 or later) wrapper of bound references.
+ * @c autoptr::ref<T> holds one ownership of a memory managed object: copies
+ * bind, moves transfer the ownership without touching the reference count and
+ * destruction unbinds.
+ *
+ * @c autoptr::make_ref<T>(args...) allocates and constructs an object in one
+ * step, in place of the usual @c calloc, constructor, @c autoptr_ctor and
+ * @c autoptr_set_allocd sequence, and @c autoptr::make_ref_array<T>(n) does the
+ * same for a managed set of @c n objects:
+ *
+ *     struct node {
+ *             struct autoptr autoptr;
+ *             int value;
+ *             node(int v) : value(v) {}
+ *     };
+ *
+ *     autoptr::ref<node> a = autoptr::make_ref<node>(42);
+ *     autoptr::ref<node> b = a;            // Bound reference
+ *     autoptr::ref<node> c = std::move(a); // Same ownership; a is now empty
+ *
+ * The type @c T is a standard-layout type that derives from @c autoptr
+ * (without data members of its own) or whose first member is a @c struct
+ * @c autoptr named @c autoptr (or @c __autoptr, as in C). @c make_ref initializes it after the C++ constructor ran;
+ * constructors must leave it alone. The C++ destructor of @c T runs when the
+ * last reference is unbound, on whichever thread unbinds it.
+ *
+ * @c ref and the factories are declared inside @c struct @c autoptr, since a
+ * namespace cannot share the name of the structure.
+ *
+ * @author Jason Graham <jgraham@compukix.net>
+ */
+
+#ifndef __AUTOPTR_HPP__
+#define __AUTOPTR_HPP__
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include <libautoptr/autoptr.h>
+
+/**
+ * @brief Bound reference to a memory managed object
+ *
+ * @tparam T Object type, starting with a @c struct @c autoptr
+ */
+template <typename T> class autoptr::ref
+{
+      public:
+        /// Empty reference
+        ref() noexcept : ptr_(nullptr) {}
+
+        /// Empty reference
+        ref(std::nullptr_t) noexcept : ptr_(nullptr) {}
+
+        /// Binds a new reference to @c ptr (may be @c nullptr)
+        explicit ref(T *ptr) : ptr_(ptr != nullptr ? static_cast<T *>(autoptr_bind(ptr)) : nullptr) {}
+
+        /// Binds a new reference to the object of @c other
+        ref(const ref &other) : ref(other.ptr_) {}
+
+        /// Takes the ownership of @c other, leaving it empty
+        ref(ref &&other) noexcept : ptr_(other.ptr_) { other.ptr_ = nullptr; }
+
+        /// Unbinds the reference
+        ~ref() { reset(); }
+
+        ref &operator=(const ref &other)
+        {
+                ref(other).swap(*this);
+                return *this;
+        }
+
+        ref &operator=(ref &&other) noexcept
+        {
+                ref(std::move(other)).swap(*this);
+                return *this;
+        }
+
+        ref &operator=(std::nullptr_t) noexcept
+        {
+                reset();
+                return *this;
+        }
+
+        /**
+         * @brief Wraps an ownership the caller already holds without binding
+         *
+         * For the creator's ownership and the bound references returned by the
+         * C API (e.g. @c autoptr_weak_lock or @c autoptr_slot_load).
+         */
+        static ref adopt(T *ptr) noexcept
+        {
+                ref r;
+                r.ptr_ = ptr;
+                return r;
+        }
+
+        /// Unbinds the reference, leaving it empty
+        void reset() noexcept
+        {
+                if (ptr_ != nullptr)
+                        autoptr_unbind(reinterpret_cast<void **>(&ptr_));
+        }
+
+        /// Gives up the ownership without unbinding and returns the object
+        T *release() noexcept
+        {
+                T *ptr = ptr_;
+                ptr_   = nullptr;
+                return ptr;
+        }
+
+        void swap(ref &other) noexcept { std::swap(ptr_, other.ptr_); }
+
+        T *get() const noexcept { return ptr_; }
+        T &operator*() const noexcept { return *ptr_; }
+        T *operator->() const noexcept { return ptr_; }
+
+        /// Element @c n of a managed set (see @c make_ref_array)
+        T &operator[](std::size_t n) const noexcept { return ptr_[n]; }
+
+        explicit operator bool() const noexcept { return ptr_ != nullptr; }
+
+      private:
+        T *ptr_;
+};
+
+template <typename T> inline bool operator==(const autoptr::ref<T> &a, const autoptr::ref<T> &b) noexcept
+{
+        return a.get() == b.get();
+}
+
+template <typename T> inline bool operator!=(const autoptr::ref<T> &a, const autoptr::ref<T> &b) noexcept
+{
+        return a.get() != b.get();
+}
+
+template <typename T> inline bool operator==(const autoptr::ref<T> &a, std::nullptr_t) noexcept
+{
+        return a.get() == nullptr;
+}
+
+template <typename T> inline bool operator!=(const autoptr::ref<T> &a, std::nullptr_t) noexcept
+{
+        return a.get() != nullptr;
+}
+
+template <typename T> inline void swap(autoptr::ref<T> &a, autoptr::ref<T> &b) noexcept
+{
+        a.swap(b);
+}
+
+namespace __autoptr_cxx
+{
+
+/*
+ * Offsets of the struct autoptr members of T named autoptr and __autoptr (the name in C); 1, never a valid offset,
+ * if T has no such member
+ */
+template <typename T, typename = void> struct member_offset : std::integral_constant<std::size_t, 1>
+{
+};
+
+template <typename T>
+struct member_offset<T, typename std::enable_if<std::is_same<decltype(T::autoptr), struct autoptr>::value>::type>
+    : std::integral_constant<std::size_t, offsetof(T, autoptr)>
+{
+};
+
+template <typename T, typename = void> struct member_offset_c : std::integral_constant<std::size_t, 1>
+{
+};
+
+template <typename T>
+struct member_offset_c<T, typename std::enable_if<std::is_same<decltype(T::__autoptr), struct autoptr>::value>::type>
+    : std::integral_constant<std::size_t, offsetof(T, __autoptr)>
+{
+};
+
+/*
+ * Tests if objects of type T start with their struct autoptr: the base class or the first member of a standard-layout
+ * type. Only standard layout places a base class at offset 0; a polymorphic type starts with its vtable pointer.
+ */
+template <typename T>
+struct header_first : std::integral_constant<bool, std::is_base_of<struct autoptr, T>::value ||
+                                                       member_offset<T>::value == 0 || member_offset_c<T>::value == 0>
+{
+};
+
+// The offsets are only taken of standard-layout types
+template <typename T>
+struct starts_with_autoptr
+    : std::conditional<std::is_standard_layout<T>::value && !std::is_polymorphic<T>::value, header_first<T>,
+                       std::false_type>::type
+{
+};
+
+template <typename T> void check_type()
+{
+        static_assert(starts_with_autoptr<T>::value, "T must derive from autoptr or start with a struct autoptr");
+        static_assert(alignof(T) <= alignof(std::max_align_t), "T is over-aligned for calloc");
+}
+
+/*
+ * Object destructor registered by make_ref; runs the C++ destructor once the last reference is unbound
+ */
+template <typename T> void destroy(void *ptr)
+{
+        if (!autoptr_destroy_ok(ptr)) {
+                autoptr_release(ptr);
+                return;
+        }
+
+        static_cast<T *>(ptr)->~T();
+        autoptr_dtor(ptr);
+}
+
+/*
+ * Constructs an object in zeroed storage and initializes its header
+ */
+template <typename T, typename... Args> T *construct(void *mem, Args &&... args)
+{
+        T *obj = new (mem) T(std::forward<Args>(args)...);
+        autoptr_ctor(obj, sizeof(T), &destroy<T>);
+        return obj;
+}
+
+} // namespace __autoptr_cxx
+
+/**
+ * @brief Allocates and constructs a heap-allocated object
+ *
+ * @param args Arguments of the constructor of @c T
+ * @return Reference holding the creator's ownership
+ * @throws std::bad_alloc if the allocation fails; exceptions of the constructor of @c T
+ */
+template <typename T, typename... Args> autoptr::ref<T> autoptr::make_ref(Args &&... args)
+{
+        __autoptr_cxx::check_type<T>();
+
+        void *mem = std::calloc(1, sizeof(T));
+        if (mem == nullptr)
+                throw std::bad_alloc();
+
+        T *obj;
+        try {
+                obj = __autoptr_cxx::construct<T>(mem, std::forward<Args>(args)...);
+        } catch (...) {
+                std::free(mem);
+                throw;
+        }
+        autoptr_set_allocd(obj, true);
+
+        return ref<T>::adopt(obj);
+}
+
+/**
+ * @brief Allocates and default-constructs a heap-allocated managed set
+ *
+ * The counterpart of allocating with @c calloc, constructing each object and
+ * calling @c autoptr_set_allocd and @c autoptr_set_managed. Sets of trivially
+ * destructible types are flagged with @c autoptr_set_trivial.
+ *
+ * @param num_managed Number of objects (at least 1)
+ * @return Reference to the first object (the manager) holding the creator's ownership
+ * @throws std::invalid_argument if @c num_managed is 0
+ * @throws std::bad_alloc if the allocation fails; exceptions of the constructor of @c T
+ */
+template <typename T> autoptr::ref<T> autoptr::make_ref_array(std::size_t num_managed)
+{
+        __autoptr_cxx::check_type<T>();
+
+        if (num_managed == 0)
+                throw std::invalid_argument("autoptr::make_ref_array: empty managed set");
+
+        void *mem = std::calloc(num_managed, sizeof(T));
+        if (mem == nullptr)
+                throw std::bad_alloc();
+
+        T *obj = static_cast<T *>(mem);
+        std::size_t n;
+        try {
+                for (n = 0; n < num_managed; ++n)
+                        __autoptr_cxx::construct<T>(obj + n);
+        } catch (...) {
+                // Destroy the objects constructed so far as independent objects
+                while (n-- > 0)
+                        __autoptr_cxx::destroy<T>(obj + n);
+                std::free(mem);
+                throw;
+        }
+        autoptr_set_allocd(obj, true);
+        autoptr_set_managed(obj, num_managed);
+        // Unbinding skips the per-object destructor calls
+        if (std::is_trivially_destructible<T>::value)
+                autoptr_set_trivial(obj);
+
+        return ref<T>::adopt(obj);
+}
+
+#endif // __AUTOPTR_HPP__
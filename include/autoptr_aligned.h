@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2017-2019 Jason Graham <jgraham@compukix.net>
+ *
+ * This file is part of libautoptr.
+ *
+ * libautoptr is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libautoptr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libautoptr.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file
+ * @brief Autoptr Aligned Allocation Definitions
+ *
+ * Allocation of heap-allocated managed objects and managed vectors on cache
+ * line boundaries, so that the autoptr struct of a hot object (reference count
+ * and mutex) does not share a cache line with the data of a neighbouring
+ * allocation. The length of an allocation is rounded up to whole cache lines.
+ *
+ * The objects of a managed vector may also be padded to whole cache lines by
+ * constructing them with the length returned by @c autoptr_aligned_stride:
+ *
+ *     const size_t stride = autoptr_aligned_stride(sizeof(struct my_struct));
+ *     struct my_struct *v = autoptr_aligned_valloc(stride, n);
+ *     for (size_t i = 0; i < n; ++i)
+ *             autoptr_ctor((char *)v + i * stride, stride, my_struct_dtor);
+ *     autoptr_aligned_set_allocd(v);
+ *     autoptr_set_managed(v, n);
+ *
+ * Allocations of at least @c AUTOPTR_ALIGNED_MAP_LEN bytes are mapped with
+ * @c mmap, aligned to huge pages and advised for transparent huge pages
+ * (where supported); smaller ones come from @c posix_memalign. An object
+ * flagged with @c autoptr_aligned_set_allocd (in place of
+ * @c autoptr_set_allocd) is given back with the matching call,
+ * @c munmap or @c free, when its last reference is unbound.
+ *
+ * @author Jason Graham <jgraham@compukix.net>
+ */
+
+#ifndef __AUTOPTR_ALIGNED_H__
+#define __AUTOPTR_ALIGNED_H__
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUTOPTR_CACHE_LINE 64 ///< Alignment in bytes of aligned allocations
+#define AUTOPTR_HUGE_PAGE (2 * 1024 * 1024) ///< Alignment in bytes of mapped allocations
+#define AUTOPTR_ALIGNED_MAP_LEN (4 * 1024 * 1024) ///< Smallest allocation length mapped with @c mmap
+
+/**
+ * @brief Rounds an object length up to whole cache lines
+ *
+ * @param obj_len Length in bytes of an object
+ * @return Length in bytes of the object padded to whole cache lines
+ */
+static inline size_t autoptr_aligned_stride(size_t obj_len)
+{
+        return (obj_len + AUTOPTR_CACHE_LINE - 1) / AUTOPTR_CACHE_LINE * AUTOPTR_CACHE_LINE;
+}
+
+/**
+ * @brief Allocates a zeroed object on a cache line boundary
+ *
+ * @param obj_len Length in bytes of the object
+ * @return Address of the object; @c NULL if it could not be allocated
+ */
+void *autoptr_aligned_alloc(size_t obj_len);
+
+/**
+ * @brief Allocates a zeroed managed vector on a cache line boundary
+ *
+ * @param obj_len Length in bytes of the objects (see @c autoptr_aligned_stride for padded objects)
+ * @param num_obj Number of objects
+ * @return Address of the first object; @c NULL if the vector could not be allocated
+ */
+void *autoptr_aligned_valloc(size_t obj_len, size_t num_obj);
+
+/**
+ * @brief Frees an allocation of @c autoptr_aligned_alloc or @c autoptr_aligned_valloc
+ *
+ * Called by @c autoptr_unbind for objects flagged with @c autoptr_aligned_set_allocd.
+ *
+ * @param ptr Address of the object (of the first object of a vector)
+ */
+void autoptr_aligned_free(void *ptr);
+
+/**
+ * @brief Sets the heap allocation flag of an object allocated with @c autoptr_aligned_alloc or
+ * @c autoptr_aligned_valloc
+ *
+ * Used in place of @c autoptr_set_allocd during construction of the object.
+ *
+ * @param ptr Address of memory managed object
+ */
+void autoptr_aligned_set_allocd(void *ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __AUTOPTR_ALIGNED_H__
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2017-2019 Jason Graham <jgraham@compukix.net>
+ *
+ * This file is part of libautoptr.
+ *
+ * libautoptr is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libautoptr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libautoptr.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file
+ * @brief Autoptr Channel Definitions
+ *
+ * A channel is a bounded first-in first-out queue of bound references shared by
+ * any number of sending and receiving threads. References are moved through
+ * it: sending takes over the reference of the sender and receiving hands it to
+ * the receiver, so a handoff updates no reference count:
+ *
+ *     struct autoptr_channel *ch = autoptr_channel_create(1024);
+ *     ...
+ *     struct job *j = job_alloc();             // Producer
+ *     while (!autoptr_channel_send(ch, (void **)&j))
+ *             sched_yield();                   // Full
+ *     ...
+ *     struct job *j = autoptr_channel_recv(ch); // Consumer
+ *     if (j != NULL) {
+ *             ...
+ *             autoptr_unbind((void **)&j);
+ *     }
+ *     ...
+ *     autoptr_channel_destroy(ch);
+ *
+ * Sending and receiving are lock-free and never block; a send to a full
+ * channel and a receive from an empty one fail immediately. Destroying a
+ * channel unbinds the references still queued in it.
+ *
+ * @author Jason Graham <jgraham@compukix.net>
+ */
+
+#ifndef __AUTOPTR_CHANNEL_H__
+#define __AUTOPTR_CHANNEL_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct autoptr_channel;
+
+/**
+ * @brief Creates an empty channel
+ *
+ * @param capacity Number of references the channel holds at most; rounded up to a power of two (at least 2)
+ * @return Channel; @c NULL if the capacity is too large or the channel could not be allocated
+ */
+struct autoptr_channel *autoptr_channel_create(size_t capacity);
+
+/**
+ * @brief Unbinds the references left in a channel and destroys it
+ *
+ * No other thread may access the channel concurrently.
+ *
+ * @param ch Channel
+ */
+void autoptr_channel_destroy(struct autoptr_channel *ch);
+
+/**
+ * @brief Moves a bound reference into a channel
+ *
+ * @param ch Channel
+ * @param ptr Pointer to bound reference (not @c NULL); set to @c NULL if the reference was sent
+ * @return @c true if the reference was sent; @c false if the channel is full, the caller keeping the reference
+ */
+bool autoptr_channel_send(struct autoptr_channel *ch, void **ptr);
+
+/**
+ * @brief Moves the oldest reference out of a channel
+ *
+ * @param ch Channel
+ * @return Bound reference, now owned by the caller (to be unbound with @c autoptr_unbind); @c NULL if the channel
+ * is empty
+ */
+void *autoptr_channel_recv(struct autoptr_channel *ch);
+
+/**
+ * @brief Gets the capacity of a channel
+ *
+ * @param ch Channel
+ * @return Number of references the channel holds at most
+ */
+size_t autoptr_channel_capacity(const struct autoptr_channel *ch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __AUTOPTR_CHANNEL_H__
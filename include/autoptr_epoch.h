@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2017-2019 Jason Graham <jgraham@compukix.net>
+ *
+ * This file is part of libautoptr.
+ *
+ * libautoptr is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libautoptr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libautoptr.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file
+ * @brief Autoptr Epoch Definitions
+ *
+ * Readers that only look at a shared object for a short while may borrow it
+ * inside an epoch instead of binding a reference, e.g. from a slot:
+ *
+ *     autoptr_epoch_start();
+ *     ...
+ *     autoptr_epoch_enter();                                   // Reader
+ *     const struct table *t = autoptr_epoch_borrow(&slot.ptr);
+ *     ...
+ *     autoptr_epoch_exit();
+ *     ...
+ *     autoptr_slot_store(&slot, new_table);                    // Writer
+ *
+ * A borrow writes to no reference count, and entering and leaving an epoch
+ * only write to a record of the calling thread, so reads cause no writes to
+ * shared cache lines.
+ *
+ * While epochs are started, an unbind that releases the last reference of a
+ * heap-allocated set retires it instead of destroying it. The set is destroyed
+ * (or queued for deferred reclaim) once every thread that was inside an epoch
+ * when it was retired has left it: by the thread retiring sets, every
+ * @c AUTOPTR_EPOCH_BATCH sets, or by @c autoptr_epoch_collect. Sets that are not
+ * heap-allocated are destroyed synchronously and may not be borrowed.
+ *
+ * A borrowed pointer is valid until the epoch is left; it must have been
+ * loaded from a location holding a bound reference, and may not be bound.
+ *
+ * @author Jason Graham <jgraham@compukix.net>
+ */
+
+#ifndef __AUTOPTR_EPOCH_H__
+#define __AUTOPTR_EPOCH_H__
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUTOPTR_EPOCH_BATCH 64 ///< Number of sets retired by a thread between two collections
+
+/**
+ * @brief Starts deferring the destruction of managed sets to the end of the epochs
+ *
+ * @return 0 on success; -1 if epochs are already started
+ */
+int autoptr_epoch_start(void);
+
+/**
+ * @brief Stops deferring destruction
+ *
+ * Waits for the threads inside an epoch to leave it and destroys all retired
+ * sets before returning. The calling thread may not be inside an epoch.
+ */
+void autoptr_epoch_stop(void);
+
+/**
+ * @brief Enters an epoch
+ *
+ * Objects borrowed by the calling thread stay alive until it leaves the
+ * epoch. Epochs nest; only the outermost one counts.
+ */
+void autoptr_epoch_enter(void);
+
+/**
+ * @brief Leaves the epoch entered last by the calling thread
+ */
+void autoptr_epoch_exit(void);
+
+/**
+ * @brief Borrows the object of a shared reference inside an epoch
+ *
+ * @param ref Location of a bound reference that writers replace atomically (e.g. @c ptr of @c autoptr_slot)
+ * @return Object referenced at @c ref, valid until the calling thread leaves its epoch; may be @c NULL
+ */
+static inline void *autoptr_epoch_borrow(void *const *ref)
+{
+        return __atomic_load_n(ref, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Destroys the retired sets of all threads whose grace period has ended
+ *
+ * Advances the global epoch if every thread inside an epoch has seen it.
+ *
+ * @return Number of managed sets destroyed
+ */
+size_t autoptr_epoch_collect(void);
+
+/**
+ * @brief Number of managed sets retired and not destroyed yet
+ */
+size_t autoptr_epoch_pending(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __AUTOPTR_EPOCH_H__
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2017-2019 Jason Graham <jgraham@compukix.net>
+ *
+ * This file is part of libautoptr.
+ *
+ * libautoptr is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libautoptr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libautoptr.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file
+ * @brief Autoptr Object Pool Definitions
+ *
+ * Fixed-size object pools for heap-allocated managed objects. A pool serves
+ * objects of one length class from aligned slabs and keeps a per-thread
+ * magazine of free objects, so that allocation and release normally take no
+ * lock and make no call to the system allocator.
+ *
+ * An object allocated from a pool is constructed as usual and flagged with
+ * @c autoptr_pool_set_allocd (in place of @c autoptr_set_allocd):
+ *
+ *     struct my_struct *s = autoptr_pool_alloc(autoptr_pool_get(sizeof(*s)));
+ *     my_struct_ctor(s);
+ *     autoptr_pool_set_allocd(s);
+ *
+ * When the last reference is unbound the object is returned to its slab by
+ * @c autoptr_unbind instead of being passed to @c free().
+ *
+ * @author Jason Graham <jgraham@compukix.net>
+ */
+
+#ifndef __AUTOPTR_POOL_H__
+#define __AUTOPTR_POOL_H__
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUTOPTR_POOL_MAX_OBJ_LEN 4096 ///< Largest object length served by a pool
+#define AUTOPTR_POOL_SLAB_LEN (64 * 1024) ///< Length in bytes (and alignment) of a pool slab
+#define AUTOPTR_POOL_MAGAZINE_LEN 64 ///< Number of free objects cached per thread and pool
+
+struct autoptr_pool;
+
+/**
+ * @brief Gets the pool for objects of a given length
+ *
+ * Pools are process-wide and keyed by the object length rounded up to 16
+ * bytes. The pool is created on first use and lives until the process exits.
+ *
+ * @param obj_len Length in bytes of the objects (at most @c AUTOPTR_POOL_MAX_OBJ_LEN)
+ * @return Pool serving objects of length @c obj_len; @c NULL if @c obj_len is 0 or above
+ * @c AUTOPTR_POOL_MAX_OBJ_LEN, or the pool could not be created
+ */
+struct autoptr_pool *autoptr_pool_get(size_t obj_len);
+
+/**
+ * @brief Allocates a zeroed object from a pool
+ *
+ * @param pool Object pool; @c NULL (as returned by a failed @c autoptr_pool_get) allocates nothing
+ * @return Address of the object; @c NULL if @c pool is @c NULL or a new slab could not be allocated
+ */
+void *autoptr_pool_alloc(struct autoptr_pool *pool);
+
+/**
+ * @brief Returns an object to the slab of its pool
+ *
+ * Called by @c autoptr_unbind for objects flagged with @c autoptr_pool_set_allocd.
+ *
+ * @param ptr Address of an object allocated by @c autoptr_pool_alloc
+ */
+void autoptr_pool_free(void *ptr);
+
+/**
+ * @brief Sets the heap allocation flag of an object allocated from a pool
+ *
+ * Used in place of @c autoptr_set_allocd during construction of the object.
+ *
+ * @param ptr Address of memory managed object
+ */
+void autoptr_pool_set_allocd(void *ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __AUTOPTR_POOL_H__
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2017-2019 Jason Graham <jgraham@compukix.net>
+ *
+ * This file is part of libautoptr.
+ *
+ * libautoptr is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libautoptr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libautoptr.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file
+ * @brief Autoptr Deferred Reclaim Definitions
+ *
+ * Moves the destruction of heap-allocated managed sets off the unbind path.
+ * While deferred reclaim is enabled, an unbind that releases the last
+ * reference of a heap-allocated set pushes its manager onto a bounded
+ * lock-free queue instead of running the object destructors. The queued sets
+ * are destroyed (destructors run in reverse and memory freed, as by
+ * @c autoptr_unbind) by a background reclaimer thread or by explicit calls to
+ * @c autoptr_reclaim_drain.
+ *
+ * Sets that are not heap-allocated are always destroyed synchronously since
+ * their storage may not outlive the unbinding scope. When the queue is full the
+ * set is destroyed synchronously as well, which bounds the queue depth.
+ *
+ * Pending sets are flushed when deferred reclaim is stopped and, once started,
+ * when the process exits normally.
+ *
+ * @author Jason Graham <jgraham@compukix.net>
+ */
+
+#ifndef __AUTOPTR_RECLAIM_H__
+#define __AUTOPTR_RECLAIM_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Enables deferred reclaim
+ *
+ * The queue of a previous start is reused if its depth is the same and
+ * reallocated otherwise.
+ *
+ * @param depth Maximum number of pending managed sets (rounded up to a power of two)
+ * @param background Starts a background reclaimer thread if @c true; otherwise pending sets are destroyed only by
+ * @c autoptr_reclaim_drain
+ * @return 0 on success; -1 if deferred reclaim is already enabled or could not be started
+ */
+int autoptr_reclaim_start(size_t depth, bool background);
+
+/**
+ * @brief Disables deferred reclaim
+ *
+ * Stops the background reclaimer (if any) and destroys all pending managed
+ * sets on the calling thread before returning.
+ */
+void autoptr_reclaim_stop(void);
+
+/**
+ * @brief Destroys the pending managed sets on the calling thread
+ *
+ * May be called concurrently with unbinds, the background reclaimer and other
+ * drains, but not with @c autoptr_reclaim_start.
+ *
+ * @return Number of managed sets destroyed
+ */
+size_t autoptr_reclaim_drain(void);
+
+/**
+ * @brief Number of managed sets waiting to be destroyed
+ */
+size_t autoptr_reclaim_pending(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __AUTOPTR_RECLAIM_H__
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2017-2019 Jason Graham <jgraham@compukix.net>
+ *
+ * This file is part of libautoptr.
+ *
+ * libautoptr is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libautoptr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libautoptr.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file
+ * @brief Autoptr Region Definitions
+ *
+ * Regions (arenas) for managed objects and managed vectors that are created
+ * and dropped in phases, e.g. the objects of one request or one frame. A
+ * region hands out storage by bumping a pointer through large chunks; the
+ * storage is only given back to the system allocator when the region is
+ * destroyed.
+ *
+ * An object allocated from a region is constructed as usual and flagged with
+ * @c autoptr_region_set_allocd (in place of @c autoptr_set_allocd):
+ *
+ *     struct my_struct *s = autoptr_region_alloc(region, sizeof(*s));
+ *     my_struct_ctor(s);
+ *     autoptr_region_set_allocd(s);
+ *     ...
+ *     autoptr_unbind((void **)&s);
+ *     ...
+ *     autoptr_region_reset(region);
+ *
+ * When the last reference is unbound the destructors run as usual, but the
+ * storage stays in the region. @c autoptr_region_reset then reclaims all of it
+ * at once in constant time (oversized allocations, which get chunks of their
+ * own, are freed one by one).
+ *
+ * The region counts its flagged managed sets that are not yet destroyed. A
+ * reset refuses to reclaim the storage while any is left, and destroying a
+ * region with managed sets left is reported and aborts in debug builds (without
+ * @c NDEBUG). With @c AUTOPTR_ASSERT the reclaimed storage is also poisoned, so
+ * an object used after its region was reset fails @c autoptr_assert.
+ *
+ * A region is allocated from and reset by one thread at a time; its managed
+ * sets may be unbound, and so destroyed, on any thread.
+ *
+ * @author Jason Graham <jgraham@compukix.net>
+ */
+
+#ifndef __AUTOPTR_REGION_H__
+#define __AUTOPTR_REGION_H__
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUTOPTR_REGION_CHUNK_LEN (64 * 1024) ///< Length in bytes of a region chunk
+#define AUTOPTR_REGION_MAX_ALLOC_LEN (AUTOPTR_REGION_CHUNK_LEN / 4) ///< Largest allocation bumped from a chunk
+
+struct autoptr_region;
+
+/**
+ * @brief Creates an empty region
+ *
+ * @return Region; @c NULL if it could not be allocated
+ */
+struct autoptr_region *autoptr_region_create(void);
+
+/**
+ * @brief Destroys a region and frees its storage
+ *
+ * Every managed set allocated from the region must have been destroyed.
+ *
+ * @param region Region
+ */
+void autoptr_region_destroy(struct autoptr_region *region);
+
+/**
+ * @brief Allocates zeroed storage from a region
+ *
+ * The storage is aligned to 16 bytes.
+ *
+ * @param region Region
+ * @param len Length in bytes of the storage
+ * @return Address of the storage; @c NULL if a new chunk could not be allocated
+ */
+void *autoptr_region_alloc(struct autoptr_region *region, size_t len);
+
+/**
+ * @brief Allocates zeroed storage for a managed vector from a region
+ *
+ * @param region Region
+ * @param obj_len Length in bytes of the objects
+ * @param num_obj Number of objects
+ * @return Address of the first object; @c NULL if the storage could not be allocated
+ */
+void *autoptr_region_valloc(struct autoptr_region *region, size_t obj_len, size_t num_obj);
+
+/**
+ * @brief Sets the region flag of a managed set allocated from a region
+ *
+ * Used in place of @c autoptr_set_allocd during construction of the object
+ * (of the first object of a managed vector).
+ *
+ * @param ptr Address of memory managed object
+ */
+void autoptr_region_set_allocd(void *ptr);
+
+/**
+ * @brief Gets the number of managed sets of a region that are not yet destroyed
+ *
+ * @param region Region
+ * @return Number of managed sets flagged with @c autoptr_region_set_allocd and not yet destroyed
+ */
+size_t autoptr_region_live(struct autoptr_region *region);
+
+/**
+ * @brief Reclaims all the storage of a region for new allocations
+ *
+ * @param region Region
+ * @return 0 on success; -1 if managed sets of the region are not yet destroyed, in which case nothing is reclaimed
+ */
+int autoptr_region_reset(struct autoptr_region *region);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __AUTOPTR_REGION_H__
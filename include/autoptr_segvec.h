@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2017-2019 Jason Graham <jgraham@compukix.net>
+ *
+ * This file is part of libautoptr.
+ *
+ * libautoptr is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libautoptr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libautoptr.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file
+ * @brief Autoptr Segmented Vector Definitions
+ *
+ * A segmented vector is a growable sequence of memory managed objects stored in
+ * fixed-size chunks. Each chunk is a managed vector with a manager of its own;
+ * a directory of chunk addresses maps an index to its object:
+ *
+ *     struct autoptr_segvec v;
+ *     autoptr_segvec_init(&v, sizeof(struct my_struct), 1024, NULL, (void (*)(void *))my_struct_dtor);
+ *     ...
+ *     struct my_struct *s = autoptr_segvec_push(&v); // Zeroed, its autoptr struct constructed
+ *     ...
+ *     struct my_struct *t = autoptr_bind(autoptr_segvec_at(&v, 42));
+ *     ...
+ *     autoptr_segvec_destroy(&v);
+ *
+ * Pushing is amortized constant time and never moves an object: growing
+ * allocates a new chunk and at most doubles the directory. A reference bound to
+ * an object keeps its chunk alive only, so a chunk is freed as soon as the
+ * vector has released it and every reference into it is gone.
+ *
+ * All objects of a chunk are constructed when it is allocated (as by
+ * @c autoptr_valloc) and destroyed with it, so the object destructor is also
+ * called on the zeroed objects never handed out by a push.
+ *
+ * A segmented vector is not synchronized: pushes and truncation may not run
+ * concurrently with any other use of the vector. The objects themselves and
+ * references to them may be shared freely.
+ *
+ * @author Jason Graham <jgraham@compukix.net>
+ */
+
+#ifndef __AUTOPTR_SEGVEC_H__
+#define __AUTOPTR_SEGVEC_H__
+
+#include <assert.h>
+#include <stddef.h>
+
+#include <libautoptr/autoptr.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Segmented vector of memory managed objects
+ */
+struct autoptr_segvec {
+        void **chunks;                             ///< Directory of the chunks (managers), each bound by the vector
+        size_t num_chunks;                         ///< Number of chunks allocated
+        size_t max_chunks;                         ///< Capacity of the directory
+        size_t len;                                ///< Number of objects pushed
+        size_t obj_len;                            ///< Length in bytes of the objects
+        unsigned int chunk_shift;                  ///< Base 2 logarithm of the number of objects per chunk
+        const struct autoptr_allocator *allocator; ///< Allocator of the chunks; @c NULL for the system allocator
+        void (*obj_dtor)(void *);                  ///< Destructor for the objects
+};
+
+/**
+ * @brief Initializes an empty segmented vector
+ *
+ * @param v Segmented vector
+ * @param obj_len Length in bytes of the objects
+ * @param chunk_len Number of objects per chunk; rounded up to a power of two
+ * @param allocator Allocator of the chunks; @c NULL for the system allocator
+ * @param obj_dtor Destructor for the objects
+ */
+void autoptr_segvec_init(struct autoptr_segvec *v, size_t obj_len, size_t chunk_len,
+                         const struct autoptr_allocator *allocator, void (*obj_dtor)(void *));
+
+/**
+ * @brief Releases the chunks of a segmented vector and destroys it
+ *
+ * Chunks holding objects still bound elsewhere are freed once the last of
+ * those references is unbound.
+ *
+ * @param v Segmented vector
+ */
+void autoptr_segvec_destroy(struct autoptr_segvec *v);
+
+/**
+ * @brief Appends an object to a segmented vector
+ *
+ * @param v Segmented vector
+ * @return Address of the new object, zeroed after its autoptr struct; @c NULL if a chunk could not be allocated
+ */
+void *autoptr_segvec_push(struct autoptr_segvec *v);
+
+/**
+ * @brief Drops the last objects of a segmented vector, releasing their chunks
+ *
+ * Objects are only dropped with their chunk, so the new length is a whole
+ * number of chunks; pushes go on with a new chunk.
+ *
+ * @param v Segmented vector
+ * @param len New length; a multiple of the chunk length, not greater than the current length
+ */
+void autoptr_segvec_truncate(struct autoptr_segvec *v, size_t len);
+
+/**
+ * @brief Gets the number of objects per chunk of a segmented vector
+ *
+ * @param v Segmented vector
+ * @return Chunk length
+ */
+static inline size_t autoptr_segvec_chunk_len(const struct autoptr_segvec *v)
+{
+        return (size_t)1 << v->chunk_shift;
+}
+
+/**
+ * @brief Gets an object of a segmented vector
+ *
+ * The object stays at its address for as long as it lives.
+ *
+ * @param v Segmented vector
+ * @param index Index of the object; less than the length of the vector
+ * @return Address of the object
+ */
+static inline void *autoptr_segvec_at(const struct autoptr_segvec *v, size_t index)
+{
+        assert(index < v->len);
+
+        const size_t offset = index & (autoptr_segvec_chunk_len(v) - 1);
+        return (char *)v->chunks[index >> v->chunk_shift] + offset * v->obj_len;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __AUTOPTR_SEGVEC_H__
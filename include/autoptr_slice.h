@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2017-2019 Jason Graham <jgraham@compukix.net>
+ *
+ * This file is part of libautoptr.
+ *
+ * libautoptr is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libautoptr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libautoptr.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file
+ * @brief Autoptr Slice Definitions
+ *
+ * A slice refers to a range of the objects of a managed set through a single
+ * bound reference to its manager, instead of one reference per object as
+ * bound by @c autoptr_vbindl:
+ *
+ *     struct autoptr_slice s = autoptr_slice_bind(v, 1000, 500); // Objects 1000 to 1499
+ *     for (size_t i = 0; i < s.len; ++i) {
+ *             struct my_struct *obj = autoptr_slice_at(&s, i);
+ *             ...
+ *     }
+ *     autoptr_slice_unbind(&s);
+ *
+ * Sub-slices made with @c autoptr_slice_sub borrow the reference of their
+ * slice and touch no count; @c autoptr_slice_dup binds a reference of their
+ * own, e.g. to hand a shard of the set to another thread:
+ *
+ *     struct autoptr_slice half = autoptr_slice_sub(&s, 250, 250);
+ *     struct autoptr_slice shard = autoptr_slice_dup(&half); // Unbound by the worker
+ *
+ * Binding, sub-slicing and unbinding a slice take constant time whatever its
+ * length.
+ *
+ * @author Jason Graham <jgraham@compukix.net>
+ */
+
+#ifndef __AUTOPTR_SLICE_H__
+#define __AUTOPTR_SLICE_H__
+
+#include <assert.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Range of the objects of a managed set
+ */
+struct autoptr_slice {
+        void *base;    ///< Address of the manager (first object) of the set; @c NULL for an empty handle
+        size_t offset; ///< Index in the set of the first object of the slice
+        size_t len;    ///< Number of objects of the slice
+        size_t stride; ///< Distance in bytes between consecutive objects (the object length)
+};
+
+/**
+ * @brief Binds a slice of a managed set
+ *
+ * @param ptr Address of any object of the managed set
+ * @param offset Index in the set of the first object of the slice
+ * @param len Number of objects of the slice; @c offset + @c len may not exceed the number of objects of the set
+ * @return Slice holding one bound reference to the set, to be unbound with @c autoptr_slice_unbind
+ */
+struct autoptr_slice autoptr_slice_bind(void *ptr, size_t offset, size_t len);
+
+/**
+ * @brief Binds another reference to the objects of a slice
+ *
+ * @param slice Bound slice or sub-slice of one
+ * @return Slice of the same objects holding a reference of its own
+ */
+struct autoptr_slice autoptr_slice_dup(const struct autoptr_slice *slice);
+
+/**
+ * @brief Unbinds the reference held by a slice
+ *
+ * Only slices returned by @c autoptr_slice_bind and @c autoptr_slice_dup hold
+ * a reference; sub-slices do not. The slice is left empty.
+ *
+ * @param slice Bound slice
+ */
+void autoptr_slice_unbind(struct autoptr_slice *slice);
+
+/**
+ * @brief Makes a sub-slice of a slice without binding
+ *
+ * The sub-slice is valid as long as the reference of @c slice is bound.
+ *
+ * @param slice Slice
+ * @param offset Index in @c slice of the first object of the sub-slice
+ * @param len Number of objects of the sub-slice; @c offset + @c len may not exceed the length of @c slice
+ * @return Sub-slice
+ */
+static inline struct autoptr_slice autoptr_slice_sub(const struct autoptr_slice *slice, size_t offset, size_t len)
+{
+        assert(offset <= slice->len && len <= slice->len - offset);
+
+        struct autoptr_slice sub = *slice;
+        sub.offset += offset;
+        sub.len = len;
+        return sub;
+}
+
+/**
+ * @brief Gets an object of a slice
+ *
+ * @param slice Slice
+ * @param index Index in @c slice of the object
+ * @return Address of the object
+ */
+static inline void *autoptr_slice_at(const struct autoptr_slice *slice, size_t index)
+{
+        assert(index < slice->len);
+
+        return (char *)slice->base + (slice->offset + index) * slice->stride;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __AUTOPTR_SLICE_H__
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2017-2019 Jason Graham <jgraham@compukix.net>
+ *
+ * This file is part of libautoptr.
+ *
+ * libautoptr is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libautoptr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libautoptr.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file
+ * @brief Autoptr Atomic Slot Definitions
+ *
+ * A slot holds a bound reference to a memory managed object that is
+ * published to many reader threads and replaced from time to time, e.g. a
+ * configuration or a routing table:
+ *
+ *     struct autoptr_slot slot;
+ *     autoptr_slot_init(&slot, table);
+ *     ...
+ *     struct table *t = autoptr_slot_load(&slot); // Reader
+ *     ...
+ *     autoptr_unbind((void **)&t);
+ *     ...
+ *     autoptr_slot_store(&slot, new_table);       // Writer
+ *
+ * Loads take no lock: a reader announces itself on one of two reader
+ * counters of the slot, reads the pointer and binds it. Writers are
+ * serialized by the slot mutex; after replacing the pointer a writer waits
+ * until no reader that may have read the displaced pointer is still binding
+ * it (a grace period of two counter flips) and then unbinds it. Writes are
+ * therefore much more expensive than loads.
+ *
+ * @author Jason Graham <jgraham@compukix.net>
+ */
+
+#ifndef __AUTOPTR_SLOT_H__
+#define __AUTOPTR_SLOT_H__
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Atomic slot holding a bound reference
+ */
+struct autoptr_slot {
+        void *ptr;             ///< Bound reference held by the slot; may be @c NULL
+        unsigned int epoch;    ///< Selects the reader counter of new loads
+        size_t readers[2];     ///< Number of loads in progress, per epoch parity
+        pthread_mutex_t mutex; ///< Serializes writers
+};
+
+/**
+ * @brief Initializes a slot
+ *
+ * @param slot Slot
+ * @param ptr Address of memory managed object to bind into the slot; may be @c NULL
+ */
+void autoptr_slot_init(struct autoptr_slot *slot, void *ptr);
+
+/**
+ * @brief Unbinds the reference held by a slot and destroys the slot
+ *
+ * No other thread may access the slot concurrently.
+ *
+ * @param slot Slot
+ */
+void autoptr_slot_destroy(struct autoptr_slot *slot);
+
+/**
+ * @brief Loads the reference held by a slot
+ *
+ * Lock-free; may be called concurrently with any other slot operation.
+ *
+ * @param slot Slot
+ * @return Bound reference to the object of the slot, to be unbound with @c autoptr_unbind; @c NULL if the slot is
+ * empty
+ */
+void *autoptr_slot_load(struct autoptr_slot *slot);
+
+/**
+ * @brief Replaces the reference held by a slot
+ *
+ * Binds @c ptr into the slot and unbinds the displaced reference once no
+ * reader can still be binding it.
+ *
+ * @param slot Slot
+ * @param ptr Address of memory managed object; may be @c NULL
+ */
+void autoptr_slot_store(struct autoptr_slot *slot, void *ptr);
+
+/**
+ * @brief Replaces the reference held by a slot and returns the displaced one
+ *
+ * @param slot Slot
+ * @param ptr Address of memory managed object to bind into the slot; may be @c NULL
+ * @return Displaced reference, now owned by the caller (to be unbound with @c autoptr_unbind); may be @c NULL
+ */
+void *autoptr_slot_exchange(struct autoptr_slot *slot, void *ptr);
+
+/**
+ * @brief Replaces the reference held by a slot if it refers to a given object
+ *
+ * @param slot Slot
+ * @param expected Address the slot is expected to hold; may be @c NULL
+ * @param desired Address of memory managed object to bind into the slot; may be @c NULL
+ * @return @c true if the slot held @c expected and now holds @c desired (the displaced reference was unbound);
+ * @c false if the slot was left unchanged
+ */
+bool autoptr_slot_compare_exchange(struct autoptr_slot *slot, void *expected, void *desired);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __AUTOPTR_SLOT_H__
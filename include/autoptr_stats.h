@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2017-2019 Jason Graham <jgraham@compukix.net>
+ *
+ * This file is part of libautoptr.
+ *
+ * libautoptr is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libautoptr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libautoptr.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file
+ * @brief Autoptr Statistics Definitions
+ *
+ * With @c AUTOPTR_STATS (configured with --enable-stats) the library counts,
+ * per object type, the objects constructed and destroyed and the references
+ * bound and unbound. A type is an @c obj_dtor and @c obj_len pair as passed to
+ * @c autoptr_ctor; the objects of a managed set count as objects of the type of
+ * their manager.
+ *
+ * Each thread counts in a table of its own without atomic read-modify-write
+ * operations; a snapshot combines the tables of all threads, including those of
+ * exited threads:
+ *
+ *     struct autoptr_stats stats[16];
+ *     size_t n = autoptr_stats_snapshot(stats, 16);
+ *     ...
+ *     autoptr_stats_dump(stderr);
+ *
+ * Without @c AUTOPTR_STATS the counting is compiled out and this header
+ * declares nothing.
+ *
+ * @author Jason Graham <jgraham@compukix.net>
+ */
+
+#ifndef __AUTOPTR_STATS_H__
+#define __AUTOPTR_STATS_H__
+
+#include <libautoptr/autoptr.h>
+
+#if AUTOPTR_STATS
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Statistics of one object type
+ */
+struct autoptr_stats {
+        void (*obj_dtor)(void *); ///< Object destructor of the type
+        size_t obj_len;           ///< Object length of the type
+        long live;                ///< Number of objects constructed and not yet destroyed
+        long peak;                ///< Peak number of live objects; exact for one thread, an upper bound otherwise
+        size_t bytes;             ///< Bytes held by the live objects (@c live times @c obj_len)
+        unsigned long binds;      ///< Number of references bound (retained)
+        unsigned long unbinds;    ///< Number of references unbound (released, including the creators' ownerships)
+};
+
+/**
+ * @brief Combines the statistics of all threads
+ *
+ * The counters of other threads are read while they keep counting, so the
+ * snapshot is not taken at one instant.
+ *
+ * @retval stats Statistics of up to @c size types, ordered by decreasing @c bytes
+ * @param size Size of @c stats
+ * @return Number of types counted so far; may exceed @c size
+ */
+size_t autoptr_stats_snapshot(struct autoptr_stats *stats, size_t size);
+
+/**
+ * @brief Writes a snapshot of the statistics of all types
+ *
+ * The snapshot is written as CSV with a header line
+ * (@c obj_dtor,obj_len,live,peak,bytes,binds,unbinds), one line per type.
+ *
+ * @param stream Output stream
+ */
+void autoptr_stats_dump(FILE *stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AUTOPTR_STATS
+
+#endif // __AUTOPTR_STATS_H__
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2017-2019 Jason Graham <jgraham@compukix.net>
+ *
+ * This file is part of libautoptr.
+ *
+ * libautoptr is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libautoptr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libautoptr.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file
+ * @brief Autoptr Parallel Teardown Definitions
+ *
+ * Splits the destruction of very large managed vectors across a pool of
+ * worker threads. A managed set is destroyed in parallel when
+ *
+ *   - its element destructors were declared independent with
+ *     @c autoptr_set_independent, i.e. they may run in any order and on any
+ *     thread,
+ *   - it has more than the threshold number of objects, and
+ *   - parallel teardown was started with @c autoptr_teardown_start:
+ *
+ *     autoptr_teardown_start(0, 100000);
+ *     ...
+ *     struct my_struct *v = calloc(n, sizeof(*v));
+ *     ...
+ *     autoptr_set_managed(v, n);
+ *     autoptr_set_independent(v);
+ *
+ * The objects other than the manager are then destroyed in blocks of
+ * @c AUTOPTR_TEARDOWN_BLOCK_LEN by the workers and the destroying thread; the
+ * manager is destroyed last, by the destroying thread, once all other objects
+ * are. Other managed sets keep the strict reverse order of @c autoptr_unbind.
+ *
+ * One set is destroyed in parallel at a time; a set that becomes due while
+ * the workers are busy is destroyed by its thread alone.
+ *
+ * @author Jason Graham <jgraham@compukix.net>
+ */
+
+#ifndef __AUTOPTR_TEARDOWN_H__
+#define __AUTOPTR_TEARDOWN_H__
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUTOPTR_TEARDOWN_MAX_WORKERS 16 ///< Largest number of worker threads
+#define AUTOPTR_TEARDOWN_BLOCK_LEN 4096 ///< Number of objects destroyed by a worker at a time
+
+/**
+ * @brief Starts parallel teardown
+ *
+ * @param num_workers Number of worker threads (at most @c AUTOPTR_TEARDOWN_MAX_WORKERS); 0 for one less than the
+ * number of online processors
+ * @param threshold Number of objects a managed set must exceed to be destroyed in parallel
+ * @return 0 on success; -1 if parallel teardown is already started or a worker could not be created, in which
+ * case the workers already created are joined and parallel teardown stays stopped
+ */
+int autoptr_teardown_start(size_t num_workers, size_t threshold);
+
+/**
+ * @brief Stops parallel teardown
+ *
+ * Waits for a parallel teardown in progress and joins the workers.
+ */
+void autoptr_teardown_stop(void);
+
+/**
+ * @brief Declares the object destructors of a managed set independent
+ *
+ * The destructors of the objects other than the manager may then run in any
+ * order, concurrently, and on threads other than the destroying one. Called
+ * after @c autoptr_set_managed.
+ *
+ * @param ptr Address of memory managed object
+ */
+void autoptr_set_independent(void *ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __AUTOPTR_TEARDOWN_H__
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2017-2019 Jason Graham <jgraham@compukix.net>
+ *
+ * This file is part of libautoptr.
+ *
+ * libautoptr is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libautoptr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libautoptr.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file
+ * @brief Autoptr Thread-Local Coalescing Definitions
+ *
+ * Coalesces the reference count updates of a thread that binds and unbinds
+ * the same objects many times, e.g. a pipeline stage working through a batch:
+ *
+ *     for (...) {
+ *             struct obj *o = autoptr_tl_bind(shared);
+ *             ...
+ *             autoptr_tl_unbind((void **)&o);
+ *     }
+ *     autoptr_tl_flush();
+ *
+ * @c autoptr_tl_unbind records the release in a buffer of the calling thread,
+ * keyed by manager, instead of updating the manager. A later
+ * @c autoptr_tl_bind of an object of the same managed set cancels a recorded
+ * release, again without touching the manager; otherwise it retains as
+ * @c autoptr_bind does. The recorded releases are applied by
+ * @c autoptr_tl_flush, when the buffer runs out of managers
+ * (@c AUTOPTR_TL_SIZE) and when the thread exits.
+ *
+ * Only releases are deferred, so the reference count of a manager never drops
+ * below the number of references actually held: the recorded releases keep a
+ * managed set alive until they are flushed, and the flush that releases the
+ * last reference destroys it as @c autoptr_unbind does. Until then
+ * @c autoptr_destroy_ok and @c autoptr_num_references see the pending releases
+ * as references.
+ *
+ * References bound with @c autoptr_tl_bind are ordinary references and may be
+ * unbound with @c autoptr_unbind (and the other way around).
+ *
+ * Statistics and traces count the binds and unbinds at their call sites, as
+ * if they were not coalesced; a traced event reports the ownerships of the
+ * manager, in which the pending releases are still counted.
+ *
+ * @author Jason Graham <jgraham@compukix.net>
+ */
+
+#ifndef __AUTOPTR_TL_H__
+#define __AUTOPTR_TL_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUTOPTR_TL_SIZE 64 ///< Number of managers with pending releases a thread buffers before flushing
+
+/**
+ * @brief Binds a reference to an object, cancelling a pending release of its managed set if any
+ *
+ * @param ptr Address of memory managed object
+ * @return Address of memory managed object
+ */
+void *autoptr_tl_bind(void *ptr);
+
+/**
+ * @brief Unbinds an object reference, deferring the release to the next flush of the calling thread
+ *
+ * @param ptr Pointer to address of memory managed object; the object address is set to @c NULL upon returning
+ */
+void autoptr_tl_unbind(void **ptr);
+
+/**
+ * @brief Applies the pending releases of the calling thread
+ *
+ * Managed sets whose last reference was pending are destroyed.
+ */
+void autoptr_tl_flush(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __AUTOPTR_TL_H__
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2017-2019 Jason Graham <jgraham@compukix.net>
+ *
+ * This file is part of libautoptr.
+ *
+ * libautoptr is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libautoptr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libautoptr.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file
+ * @brief Autoptr Event Trace Definitions
+ *
+ * With @c AUTOPTR_TRACE (configured with --enable-trace) the library records
+ * every bind, release, unbind and destruction of a managed set as an event
+ * carrying the object and manager addresses, the number of ownerships after
+ * the operation, the thread, a timestamp and the address the operation was called
+ * from. Each thread records into a ring of its own of @c AUTOPTR_TRACE_RING_LEN
+ * events without locking; once a ring is full its oldest events are
+ * overwritten. A dump writes the events of all threads, including exited ones,
+ * to a binary file:
+ *
+ *     FILE *f = fopen("autoptr.trace", "wb");
+ *     autoptr_trace_dump(f);
+ *     fclose(f);
+ *
+ * which the @c autoptr_trace tool summarizes offline (hot call sites and
+ * bind-to-unbind reference lifetimes):
+ *
+ *     $ autoptr_trace autoptr.trace
+ *
+ * The file format below is declared in every build so that the tool can read
+ * traces of any build. Without @c AUTOPTR_TRACE the recording is compiled out
+ * and no trace procedure is declared.
+ *
+ * @author Jason Graham <jgraham@compukix.net>
+ */
+
+#ifndef __AUTOPTR_TRACE_H__
+#define __AUTOPTR_TRACE_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <libautoptr/autoptr_config.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUTOPTR_TRACE_RING_LEN 16384 ///< Number of events kept per thread (power of two)
+
+#define AUTOPTR_TRACE_MAGIC "AUTOPTRT" ///< First 8 bytes of a trace file
+#define AUTOPTR_TRACE_VERSION 1        ///< Version of the trace file format
+
+// Traced events
+#define AUTOPTR_TRACE_BIND 0    ///< References bound (@c autoptr_bind, @c autoptr_retain_n)
+#define AUTOPTR_TRACE_RELEASE 1 ///< Ownerships released (@c autoptr_release_n)
+#define AUTOPTR_TRACE_UNBIND 2  ///< References unbound (@c autoptr_unbind and the list unbinds)
+#define AUTOPTR_TRACE_DESTROY 3 ///< Managed set destroyed
+#define AUTOPTR_TRACE_NUM_EVENTS 4
+
+/**
+ * @brief Header of a trace file
+ *
+ * Followed by @c num_events events in timestamp order and @c num_callers caller
+ * records in address order, each followed by its module path and symbol name
+ * (without terminating NUL characters).
+ */
+struct autoptr_trace_header {
+        char magic[8];        ///< @c AUTOPTR_TRACE_MAGIC
+        uint32_t version;     ///< @c AUTOPTR_TRACE_VERSION
+        uint32_t event_len;   ///< Size of an event record
+        uint64_t num_events;  ///< Number of events in the file
+        uint64_t num_lost;    ///< Number of events overwritten in the rings before the dump
+        uint64_t num_callers; ///< Number of distinct callers
+};
+
+/**
+ * @brief Event record of a trace file
+ */
+struct autoptr_trace_event {
+        uint64_t time_ns; ///< Monotonic clock timestamp
+        uint64_t ptr;     ///< Address of the object
+        uint64_t manager; ///< Address of the manager of its set
+        uint64_t caller;  ///< Return address of the call site of the operation
+        int32_t count;    ///< Ownerships (references plus the creator) after the operation; -1 if sharded
+        int32_t n;        ///< Number of references bound or released; number of objects of a destroyed set
+        uint32_t thread;  ///< Trace ring (thread) number, from 1
+        uint32_t event;   ///< One of the @c AUTOPTR_TRACE_* events
+};
+
+/**
+ * @brief Caller record of a trace file
+ *
+ * Resolved when dumping, so that call sites in position-independent code can
+ * be located offline, e.g. with @c addr2line -e @c module @c offset.
+ */
+struct autoptr_trace_caller {
+        uint64_t caller;     ///< Caller address as recorded in the events
+        uint64_t offset;     ///< Offset of the address in its module; the address itself if unresolved
+        uint32_t module_len; ///< Length of the module path that follows
+        uint32_t symbol_len; ///< Length of the nearest symbol name that follows the module path
+};
+
+#if AUTOPTR_TRACE
+
+/**
+ * @brief Writes the events recorded by all threads as a trace file
+ *
+ * The rings of other threads are read while they keep recording; events
+ * overwritten meanwhile are left out and counted as lost.
+ *
+ * @param stream Output stream, opened in binary mode
+ * @return 0 on success; -1 if the trace could not be collected or written
+ */
+int autoptr_trace_dump(FILE *stream);
+
+#endif // AUTOPTR_TRACE
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __AUTOPTR_TRACE_H__
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2017-2019 Jason Graham <jgraham@compukix.net>
+ *
+ * This file is part of libautoptr.
+ *
+ * libautoptr is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libautoptr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libautoptr.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file
+ * @brief Autoptr Weak Reference Definitions
+ *
+ * A weak reference refers to a memory managed object without keeping it
+ * alive. It is upgraded to a bound reference with @c autoptr_weak_lock, which
+ * fails once the last bound reference was unbound and the managed set
+ * destroyed:
+ *
+ *     struct autoptr_weak w;
+ *     autoptr_weak_bind(&w, obj);
+ *     ...
+ *     struct my_struct *s = autoptr_weak_lock(&w);
+ *     if (s != NULL) {
+ *             ...
+ *             autoptr_unbind((void **)&s);
+ *     }
+ *     ...
+ *     autoptr_weak_unbind(&w);
+ *
+ * The manager of the set counts its weak references. When a set with weak
+ * references is destroyed, the object destructors run as usual but the
+ * storage of a heap-allocated set is freed by the last @c autoptr_weak_unbind
+ * instead. The storage of a set that is not heap-allocated must outlive its
+ * weak references.
+ *
+ * Upgrading takes no lock with @c AUTOPTR_ATOMIC and only the manager mutex
+ * otherwise. Weak references are not available in compact or biased builds
+ * (@c AUTOPTR_WEAK is 0).
+ *
+ * @author Jason Graham <jgraham@compukix.net>
+ */
+
+#ifndef __AUTOPTR_WEAK_H__
+#define __AUTOPTR_WEAK_H__
+
+#include <libautoptr/autoptr.h>
+
+#if AUTOPTR_WEAK
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Weak reference to a memory managed object
+ */
+struct autoptr_weak {
+        void *ptr;               ///< Address of the referenced object; @c NULL if unbound
+        struct autoptr *manager; ///< Manager of the managed set of the object
+};
+
+/**
+ * @brief Binds a weak reference to an object
+ *
+ * @param weak Weak reference
+ * @param ptr Address of memory managed object (a bound reference or the creator's); may be @c NULL
+ */
+void autoptr_weak_bind(struct autoptr_weak *weak, void *ptr);
+
+/**
+ * @brief Binds a weak reference to the object of another weak reference
+ *
+ * Succeeds whether or not the object has expired.
+ *
+ * @param weak Weak reference
+ * @param other Bound or unbound weak reference
+ */
+void autoptr_weak_copy(struct autoptr_weak *weak, const struct autoptr_weak *other);
+
+/**
+ * @brief Unbinds a weak reference
+ *
+ * Frees the storage of an expired heap-allocated set if this was its last
+ * weak reference.
+ *
+ * @param weak Weak reference; left unbound
+ */
+void autoptr_weak_unbind(struct autoptr_weak *weak);
+
+/**
+ * @brief Upgrades a weak reference to a bound reference
+ *
+ * @param weak Weak reference
+ * @return Bound reference to the object, to be unbound with @c autoptr_unbind; @c NULL if the weak reference is
+ * unbound or the object has expired
+ */
+void *autoptr_weak_lock(const struct autoptr_weak *weak);
+
+/**
+ * @brief Tests if the object of a weak reference was destroyed
+ *
+ * A @c false result may be outdated by the time it is returned; use
+ * @c autoptr_weak_lock to access the object.
+ *
+ * @param weak Weak reference
+ * @return @c true if the weak reference is unbound or the object was destroyed
+ */
+bool autoptr_weak_expired(const struct autoptr_weak *weak);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AUTOPTR_WEAK
+
+#endif // __AUTOPTR_WEAK_H__
@@ -17,18 +17,88 @@
  * License along with libautoptr.  If not, see
  * <https://www.gnu.org/licenses/>.
  */
-#include <libautoptr/autoptr.h>
+#include "autoptr_private.h"
+#include <libautoptr/autoptr_aligned.h>
+#include <libautoptr/autoptr_pool.h>
+#include <limits.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <unistd.h>
 
-#define AUTOPTR(a) ((struct autoptr *)(a))
-#define AUTOPTR_LOCK(a) (pthread_mutex_lock(&AUTOPTR(a)->mutex))
-#define AUTOPTR_UNLOCK(a) (pthread_mutex_unlock(&AUTOPTR(a)->mutex))
+#if AUTOPTR_COMPACT
 
-#define AUTOPTR_M(a) (AUTOPTR(a)->manager)
-#define AUTOPTR_M_LOCK(a) (pthread_mutex_lock(&AUTOPTR_M(a)->mutex))
-#define AUTOPTR_M_UNLOCK(a) (pthread_mutex_unlock(&AUTOPTR_M(a)->mutex))
+#define TYPE_HASH_SIZE (1 << 17) // Load factor of at most 1/2 for AUTOPTR_MAX_TYPES
+
+struct autoptr_type autoptr_types[AUTOPTR_MAX_TYPES];
+
+// Open addressing index into autoptr_types; slots hold the type index + 1 (0 when empty). Slots are published
+// with release semantics after the table entry is written so that lookups need no lock.
+static atomic_ushort type_hash[TYPE_HASH_SIZE];
+static size_t num_types                  = 0;
+static pthread_mutex_t type_mutex        = PTHREAD_MUTEX_INITIALIZER;
+static _Thread_local int last_type_index = -1;
+
+static inline bool type_equal(const struct autoptr_type *type, const struct autoptr_type *key)
+{
+        return type->obj_len == key->obj_len && type->obj_dtor == key->obj_dtor &&
+               type->obj_vdtor == key->obj_vdtor && type->allocator == key->allocator;
+}
+
+static size_t type_hash_index(size_t obj_len, void (*obj_dtor)(void *))
+{
+        uint64_t h = (uint64_t)(uintptr_t)obj_dtor ^ ((uint64_t)obj_len * 0x9E3779B97F4A7C15ULL);
+        h ^= h >> 31;
+        h *= 0xBF58476D1CE4E5B9ULL;
+        h ^= h >> 29;
+        return h & (TYPE_HASH_SIZE - 1);
+}
+
+/*
+ * Returns the type table index of a type, registering it on first use. Types that only differ by their vector
+ * destructor or allocator share a hash chain.
+ */
+static uint16_t type_index(const struct autoptr_type *key)
+{
+        // The objects of a vector are constructed one after the other with the same type
+        if (last_type_index >= 0 && type_equal(&autoptr_types[last_type_index], key))
+                return last_type_index;
+
+        const size_t h0 = type_hash_index(key->obj_len, key->obj_dtor);
+        size_t h;
+        unsigned short slot;
+
+        for (h = h0; (slot = atomic_load_explicit(&type_hash[h], memory_order_acquire)) != 0;
+             h = (h + 1) & (TYPE_HASH_SIZE - 1)) {
+                if (type_equal(&autoptr_types[slot - 1], key))
+                        return last_type_index = slot - 1;
+        }
+
+        pthread_mutex_lock(&type_mutex);
+
+        // Another thread may have registered the type (or a colliding one) since the lookup
+        for (h = h0; (slot = atomic_load_explicit(&type_hash[h], memory_order_relaxed)) != 0;
+             h = (h + 1) & (TYPE_HASH_SIZE - 1)) {
+                if (type_equal(&autoptr_types[slot - 1], key))
+                        break;
+        }
+
+        if (slot == 0) {
+                if (num_types == AUTOPTR_MAX_TYPES) {
+                        fprintf(stderr, "autoptr_ctor: more than %d distinct object types\n", AUTOPTR_MAX_TYPES);
+                        exit(EXIT_FAILURE);
+                }
+                autoptr_types[num_types] = *key;
+                slot                     = ++num_types;
+                atomic_store_explicit(&type_hash[h], slot, memory_order_release);
+        }
+
+        pthread_mutex_unlock(&type_mutex);
+
+        return last_type_index = slot - 1;
+}
+
+#endif // AUTOPTR_COMPACT
 
 void autoptr_ctor(void *ptr, size_t obj_len, void (*obj_dtor)(void *))
 {
@@ -36,81 +106,402 @@ void autoptr_ctor(void *ptr, size_t obj_len, void (*obj_dtor)(void *))
 
         memset(ptr, 0, sizeof(struct autoptr));
 
+#if AUTOPTR_COMPACT
+        atomic_init(&AUTOPTR(ptr)->r_count, 0);
+        AUTOPTR(ptr)->type    = type_index(&(struct autoptr_type){.obj_len = obj_len, .obj_dtor = obj_dtor});
+        AUTOPTR(ptr)->manager = AUTOPTR(ptr); // defaults to self
+#else
         AUTOPTR(ptr)->__magic = AUTOPTR_MAGIC;
-        assert(pthread_mutex_init(&AUTOPTR(ptr)->mutex, NULL) == 0);
+#if AUTOPTR_BIASED
+        // The constructing thread owns the counts; without an owner record the object starts merged
+        struct autoptr_brc_owner *owner = __autoptr_brc_register();
+        if (owner != NULL) {
+                AUTOPTR(ptr)->brc_local = 1;
+                atomic_init(&AUTOPTR(ptr)->r_count, 0);
+        } else {
+                atomic_init(&AUTOPTR(ptr)->r_count, AUTOPTR_BRC_ONE | AUTOPTR_BRC_MERGED);
+        }
+        atomic_init(&AUTOPTR(ptr)->brc_owner, owner);
+#elif AUTOPTR_ATOMIC
+        atomic_init(&AUTOPTR(ptr)->r_count, 0);
+        atomic_init(&AUTOPTR(ptr)->w_count, 1);
+#if AUTOPTR_SHARDED
+        atomic_init(&AUTOPTR(ptr)->shards, NULL);
+#endif
+#else
+        AUTOPTR(ptr)->w_count = 1;
+#endif
+        __autoptr_lock_init(AUTOPTR(ptr));
         AUTOPTR(ptr)->obj_len     = obj_len;
         AUTOPTR(ptr)->obj_dtor    = obj_dtor;
         AUTOPTR(ptr)->manager     = AUTOPTR(ptr); // defaults to self
         AUTOPTR(ptr)->num_managed = 1;
+#endif
+        AUTOPTR_STATS_COUNT(AUTOPTR(ptr), AUTOPTR_STATS_CTOR, 1);
 }
 
 void autoptr_dtor(void *ptr)
 {
         autoptr_assert(ptr);
-        pthread_mutex_destroy(&AUTOPTR(ptr)->mutex);
+        AUTOPTR_STATS_COUNT(AUTOPTR_M(ptr), AUTOPTR_STATS_DTOR, 1);
+#if AUTOPTR_SHARDED
+        // Nothing uses the shards of a set being destroyed; the manager goes last
+        free(atomic_exchange_explicit(&AUTOPTR(ptr)->shards, NULL, memory_order_relaxed));
+#endif
+#if AUTOPTR_WEAK
+        // The header of an expired manager is kept for its weak references
+        if (AUTOPTR(ptr)->manager == AUTOPTR(ptr) && __autoptr_expired(AUTOPTR(ptr)))
+                return;
+#endif
+        __autoptr_lock_destroy(AUTOPTR(ptr));
 	memset(ptr, 0, sizeof(struct autoptr));
 }
 
 void autoptr_zero_obj(void *ptr)
 {
 	autoptr_assert(ptr);
-	assert( AUTOPTR(ptr)->obj_len >= sizeof(struct autoptr));	
+	const size_t obj_len = __autoptr_obj_len(AUTOPTR_M(ptr));
+	assert( obj_len >= sizeof(struct autoptr));
 
-	const size_t zero_len = AUTOPTR(ptr)->obj_len - sizeof(struct autoptr);
+	const size_t zero_len = obj_len - sizeof(struct autoptr);
 	memset((char *)ptr + sizeof(struct autoptr), 0, zero_len);
 	
 	
 }
 void autoptr_set_obj(void *ptr, size_t obj_len, void (*obj_dtor)(void *))
 {
+#if AUTOPTR_STATS
+        // The objects of the set move to the new type
+        const long num_managed = (long)__autoptr_num_managed(AUTOPTR_M(ptr));
+        AUTOPTR_STATS_COUNT(AUTOPTR_M(ptr), AUTOPTR_STATS_DTOR, num_managed);
+#endif
+#if AUTOPTR_COMPACT
+        struct autoptr_type type = autoptr_types[AUTOPTR_M(ptr)->type];
+        type.obj_len             = obj_len;
+        type.obj_dtor            = obj_dtor;
+        AUTOPTR_M(ptr)->type     = type_index(&type);
+#else
         AUTOPTR_M(ptr)->obj_len  = obj_len;
         AUTOPTR_M(ptr)->obj_dtor = obj_dtor;
+#endif
+#if AUTOPTR_STATS
+        AUTOPTR_STATS_COUNT(AUTOPTR_M(ptr), AUTOPTR_STATS_CTOR, num_managed);
+#endif
 }
 
-void autoptr_unbind(void **ptr)
+void autoptr_set_vdtor(void *ptr, void (*obj_vdtor)(void *, size_t))
 {
-        if (*ptr == NULL)
-                goto finish;
+        autoptr_assert(ptr);
+#if AUTOPTR_COMPACT
+        struct autoptr_type type = autoptr_types[AUTOPTR_M(ptr)->type];
+        type.obj_vdtor           = obj_vdtor;
+        AUTOPTR_M(ptr)->type     = type_index(&type);
+#else
+        AUTOPTR_M(ptr)->obj_vdtor = obj_vdtor;
+#endif
+}
 
-        if (AUTOPTR_M(*ptr) == NULL)
-                goto finish;
+void autoptr_set_trivial(void *ptr)
+{
+        autoptr_assert(ptr);
+#if AUTOPTR_COMPACT
+        AUTOPTR_M(ptr)->flags |= AUTOPTR_F_TRIVIAL;
+#else
+        AUTOPTR_M(ptr)->trivial = true;
+#endif
+}
 
-        if (!autoptr_destroy_ok(*ptr)) {
-                autoptr_release(*ptr);
-                goto finish;
+void autoptr_set_allocator(void *ptr, const struct autoptr_allocator *allocator)
+{
+        autoptr_set_allocd(ptr, true);
+
+        AUTOPTR_M_LOCK(ptr);
+#if AUTOPTR_COMPACT
+        struct autoptr_type type = autoptr_types[AUTOPTR_M(ptr)->type];
+        type.allocator           = allocator;
+        AUTOPTR_M(ptr)->type     = type_index(&type);
+#else
+        AUTOPTR_M(ptr)->allocator = allocator;
+#endif
+        AUTOPTR_M_UNLOCK(ptr);
+}
+
+void *autoptr_alloc(size_t obj_len, void (*obj_dtor)(void *))
+{
+        return autoptr_valloc_with(NULL, obj_len, 1, obj_dtor);
+}
+
+void *autoptr_valloc(size_t obj_len, size_t num_managed, void (*obj_dtor)(void *))
+{
+        return autoptr_valloc_with(NULL, obj_len, num_managed, obj_dtor);
+}
+
+void *autoptr_alloc_with(const struct autoptr_allocator *allocator, size_t obj_len, void (*obj_dtor)(void *))
+{
+        return autoptr_valloc_with(allocator, obj_len, 1, obj_dtor);
+}
+
+void *autoptr_valloc_with(const struct autoptr_allocator *allocator, size_t obj_len, size_t num_managed,
+                          void (*obj_dtor)(void *))
+{
+        if (num_managed == 0 || obj_len > SIZE_MAX / num_managed)
+                return NULL;
+
+        const size_t len = obj_len * num_managed;
+        char *ptr;
+
+        if (allocator != NULL) {
+                if ((ptr = allocator->alloc(len, allocator->ctx)) == NULL)
+                        return NULL;
+                memset(ptr, 0, len);
+        } else if ((ptr = calloc(num_managed, obj_len)) == NULL) {
+                return NULL;
+        }
+
+        for (size_t i = 0; i < num_managed; ++i)
+                autoptr_ctor(ptr + obj_len * i, obj_len, obj_dtor);
+
+        // Nothing else sees the set yet, so the manager is set up without its lock
+#if AUTOPTR_COMPACT
+        AUTOPTR(ptr)->flags |= AUTOPTR_F_ALLOCD;
+        if (allocator != NULL) {
+                struct autoptr_type type = autoptr_types[AUTOPTR(ptr)->type];
+                type.allocator           = allocator;
+                AUTOPTR(ptr)->type       = type_index(&type);
         }
+#else
+        AUTOPTR(ptr)->allocd    = true;
+        AUTOPTR(ptr)->allocator = allocator;
+#endif
+        if (num_managed > 1)
+                autoptr_set_managed(ptr, num_managed);
+
+        return ptr;
+}
+
+__thread struct autoptr *__autoptr_destroying = NULL;
 
-        // The lock shouldn't be needed since all object references have been cleared
-        // AUTOPTR_M_LOCK(*ptr);
+void __autoptr_destroy(struct autoptr *manager)
+{
+        size_t num_managed                   = __autoptr_num_managed(manager);
+        const struct autoptr_storage storage = __autoptr_storage(manager);
+        const size_t obj_len                 = __autoptr_obj_len(manager);
+        void (*obj_dtor)(void *)             = __autoptr_obj_dtor(manager);
+        void (*obj_vdtor)(void *, size_t)    = __autoptr_obj_vdtor(manager);
+#if AUTOPTR_WEAK
+        const bool expired = __autoptr_expired(manager);
+#endif
+        AUTOPTR_TRACE_EVENT(AUTOPTR_TRACE_DESTROY, manager, manager, (int)num_managed, NULL);
+
+        // Destructors may destroy other sets in turn
+        struct autoptr *const outer = __autoptr_destroying;
+        __autoptr_destroying        = manager;
+
+        if (obj_vdtor != NULL || __autoptr_trivial(manager)) {
+                // One call for the whole range (if any); only the autoptr struct of the manager needs tearing down
+                if (obj_vdtor != NULL)
+                        obj_vdtor(manager, num_managed);
+                AUTOPTR_STATS_COUNT(manager, AUTOPTR_STATS_DTOR, (long)num_managed - 1);
+                autoptr_dtor(manager);
+        } else {
+                // Call the destructor for all objects (going in reverse); the manager goes last
+                if (__autoptr_independent(manager) && __autoptr_teardown(manager))
+                        num_managed = 1;
 
-        struct autoptr *manager = AUTOPTR_M(*ptr);
-        size_t num_managed      = manager->num_managed;
-        bool allocd             = manager->allocd;
+                for (ssize_t i = num_managed - 1; i >= 0; --i) {
+                        void *obj = (void *)((char *)manager + obj_len * i);
 
-        // Call the destructor for all objects (going in reverse)
-        for (ssize_t i = num_managed - 1; i >= 0; --i) {
-                void *obj = (void *)((char *)manager + manager->obj_len * i);
+                        if (i > 0) {
+                                assert(AUTOPTR(obj)->manager == manager);
+#if !AUTOPTR_COMPACT
+                                assert(AUTOPTR(obj)->num_managed == 0);
+#endif
+                        }
 
-                if (i > 0) {
-                        assert(AUTOPTR(obj)->manager == manager);
-                        assert(AUTOPTR(obj)->num_managed == 0);
+                        obj_dtor(obj);
                 }
+        }
+        __autoptr_destroying = outer;
 
-                manager->obj_dtor(obj);
+#if AUTOPTR_WEAK
+        // The last weak reference frees the storage of an expired set
+        if (expired) {
+                __autoptr_expired_release(manager);
+                return;
         }
+#endif
+        __autoptr_free(manager, &storage);
+}
 
-        if (allocd) {
+void __autoptr_free(struct autoptr *manager, const struct autoptr_storage *storage)
+{
+        if (storage->allocd) {
                 // We free the manager object
-                free(manager);
+                if (storage->allocator != NULL)
+                        storage->allocator->free(manager, storage->len, storage->allocator->ctx);
+                else if (storage->pooled)
+                        autoptr_pool_free(manager);
+                else if (storage->aligned)
+                        autoptr_aligned_free(manager);
+                else
+                        free(manager);
+        }
+        if (storage->regional)
+                __autoptr_region_release(manager);
+}
+
+void __autoptr_reclaim(struct autoptr *manager)
+{
+#if AUTOPTR_BIASED
+        // Leave the counts merged with the single ownership of the destroying thread so that the object destructors
+        // see autoptr_destroy_ok() from any thread
+        __atomic_store_n(&manager->brc_local, 0, __ATOMIC_RELAXED);
+        atomic_store_explicit(&manager->brc_owner, NULL, memory_order_relaxed);
+        atomic_store_explicit(&manager->r_count, AUTOPTR_BRC_ONE | AUTOPTR_BRC_MERGED, memory_order_relaxed);
+#endif
+#if AUTOPTR_WEAK
+        if (!__autoptr_expire(manager))
+                return;
+#endif
+        if (__autoptr_allocd(manager) && (__autoptr_epoch_defer(manager) || __autoptr_reclaim_defer(manager)))
+                return;
+
+        __autoptr_destroy(manager);
+}
+
+bool __autoptr_release_last(struct autoptr *manager, int n)
+{
+        bool last;
+
+#if AUTOPTR_SHARDED
+        // The shards hold references on the count until drained
+        if (__autoptr_shard_add(manager, -n, __ATOMIC_RELEASE))
+                return false;
+#endif
+#if AUTOPTR_BIASED
+        if (__autoptr_brc_owned(manager)) {
+                const int shared = atomic_load_explicit(&manager->r_count, memory_order_acquire);
+                last             = !(shared & AUTOPTR_BRC_QUEUED) &&
+                       __atomic_load_n(&manager->brc_local, __ATOMIC_RELAXED) + __autoptr_brc_count(shared) == n;
+                if (!last)
+                        __autoptr_brc_release(manager, n);
+        } else {
+                // Unmerged counts are merged, and the object destroyed, by the owner
+                const int shared = __autoptr_brc_shared_release(manager, n, __ATOMIC_ACQ_REL);
+                last             = (shared & AUTOPTR_BRC_MERGED) && __autoptr_brc_count(shared) == 0;
         }
+#elif AUTOPTR_ATOMIC
+        // The count never drops below zero, even transiently, so that weak references see no false expiry
+        int r_count = atomic_load_explicit(&manager->r_count, memory_order_relaxed);
+        do {
+                last = (r_count < n);
+                // The count only reaches below n when the caller holds every ownership
+                assert(!last || r_count == n - 1);
+        } while (!atomic_compare_exchange_weak_explicit(&manager->r_count, &r_count, last ? 0 : r_count - n,
+                                                        memory_order_acq_rel, memory_order_relaxed));
+#else
+        AUTOPTR_M_LOCK(manager);
+        last = (manager->r_count < n);
+        if (last) {
+                assert(manager->r_count == n - 1);
+                manager->r_count = 0;
+        } else {
+                manager->r_count -= n;
+        }
+        AUTOPTR_M_UNLOCK(manager);
+#endif
+        return last;
+}
+
+/*
+ * Releases an ownership for a public procedure; caller is its call site (traced)
+ */
+static bool release_last(void *ptr, __attribute__((unused)) const void *caller)
+{
+        autoptr_assert(ptr);
+
+        // The ownerships of a set this thread is destroying are released already
+        if (AUTOPTR_M(ptr) == __autoptr_destroying)
+                return true;
+
+        AUTOPTR_STATS_COUNT(AUTOPTR_M(ptr), AUTOPTR_STATS_UNBIND, 1);
+        AUTOPTR_TRACE_EVENT(AUTOPTR_TRACE_UNBIND, ptr, AUTOPTR_M(ptr), 1, caller);
+
+        // Testing for the last reference and releasing are one step, so that concurrent unbinds (and weak
+        // reference upgrades) cannot both miss it
+        return __autoptr_release_last(AUTOPTR_M(ptr), 1);
+}
+
+/*
+ * Unbinds a reference for a public procedure; caller is its call site (traced)
+ */
+static void unbind(void **ptr, const void *caller)
+{
+        if (*ptr == NULL)
+                goto finish;
+
+        if (AUTOPTR_M(*ptr) == NULL)
+                goto finish;
+
+        if (release_last(*ptr, caller))
+                autoptr_destroy(*ptr);
 finish:
         *ptr = NULL;
 }
 
+bool autoptr_release_last(void *ptr)
+{
+        return release_last(ptr, __builtin_return_address(0));
+}
+
+void autoptr_destroy(void *ptr)
+{
+        __autoptr_reclaim(AUTOPTR_M(ptr));
+}
+
+void autoptr_unbind(void **ptr)
+{
+        unbind(ptr, __builtin_return_address(0));
+}
+
+/*
+ * Largest part of a reference count that fits the int count of a single update
+ */
+static inline int group_chunk(size_t count)
+{
+        return count > INT_MAX ? INT_MAX : (int)count;
+}
+
+/*
+ * Retains count references of a managed set in chunks of at most INT_MAX
+ */
+static inline AUTOPTR_TRACE_INLINE void retain_chunked(void *ptr, size_t count)
+{
+        while (count > 0) {
+                const int chunk = group_chunk(count);
+                autoptr_retain_n(ptr, chunk);
+                count -= chunk;
+        }
+}
+
 void autoptr_vbindl(void *ptr, size_t size, void *ptr_list[])
 {
-        for (size_t n       = 0; n < size; ++n)
-                ptr_list[n] = autoptr_bind(ptr + AUTOPTR(ptr)->obj_len * n);
+        if (size == 0)
+                return;
+
+        const size_t obj_len = __autoptr_obj_len(AUTOPTR_M(ptr));
+
+        // Retain each run of objects sharing a manager at once
+        size_t first = 0;
+        for (size_t n = 0; n < size; ++n) {
+                ptr_list[n] = (char *)ptr + obj_len * n;
+
+                if (AUTOPTR_M(ptr_list[n]) != AUTOPTR_M(ptr_list[first])) {
+                        retain_chunked(ptr_list[first], n - first);
+                        first = n;
+                }
+        }
+        retain_chunked(ptr_list[first], size - first);
 }
 
 void autoptr_lbindl(void *ptr[], size_t size, void *ptr_list[])
@@ -122,13 +513,114 @@ void autoptr_lbindl(void *ptr[], size_t size, void *ptr_list[])
 void autoptr_lunbind(void *ptr_list[], size_t size)
 {
         for (size_t n = 0; n < size; ++n)
-                autoptr_unbind(ptr_list + n);
+                unbind(ptr_list + n, __builtin_return_address(0));
+}
+
+struct manager_group {
+        struct autoptr *manager;
+        size_t count; ///< References of the list to the manager; updated in chunks of at most INT_MAX
+};
+
+static int compare_manager_group(const void *a, const void *b)
+{
+        const uintptr_t ma = (uintptr_t)((const struct manager_group *)a)->manager;
+        const uintptr_t mb = (uintptr_t)((const struct manager_group *)b)->manager;
+        return (ma > mb) - (ma < mb);
+}
+
+/*
+ * Counts the references of a list per manager. Returns the number of distinct managers.
+ */
+static size_t group_managers(void *ptr_list[], size_t size, struct manager_group *group)
+{
+        size_t num_groups = 0;
+
+        // Coalesce runs of references to the same managed set first (e.g. lists bound with autoptr_vbindl)
+        for (size_t n = 0; n < size; ++n) {
+                if (ptr_list[n] == NULL || AUTOPTR_M(ptr_list[n]) == NULL)
+                        continue;
+
+                struct autoptr *manager = AUTOPTR_M(ptr_list[n]);
+                if (num_groups > 0 && group[num_groups - 1].manager == manager) {
+                        group[num_groups - 1].count++;
+                } else {
+                        group[num_groups].manager = manager;
+                        group[num_groups].count   = 1;
+                        num_groups++;
+                }
+        }
+
+        if (num_groups <= 1)
+                return num_groups;
+
+        // Merge the runs of managers appearing more than once
+        qsort(group, num_groups, sizeof(*group), compare_manager_group);
+
+        size_t m = 0;
+        for (size_t n = 1; n < num_groups; ++n) {
+                if (group[n].manager == group[m].manager)
+                        group[m].count += group[n].count;
+                else
+                        group[++m] = group[n];
+        }
+        return m + 1;
+}
+
+void autoptr_lbindl_batch(void *ptr[], size_t size, void *ptr_list[])
+{
+        struct manager_group *group = malloc(size * sizeof(*group));
+        if (group == NULL) {
+                autoptr_lbindl(ptr, size, ptr_list);
+                return;
+        }
+
+        for (size_t n = 0; n < size; ++n)
+                ptr_list[n] = ptr[n];
+
+        const size_t num_groups = group_managers(ptr_list, size, group);
+        for (size_t n = 0; n < num_groups; ++n)
+                retain_chunked(group[n].manager, group[n].count);
+
+        free(group);
+}
+
+void autoptr_lunbind_batch(void *ptr_list[], size_t size)
+{
+        struct manager_group *group = malloc(size * sizeof(*group));
+        if (group == NULL) {
+                autoptr_lunbind(ptr_list, size);
+                return;
+        }
+
+        const size_t num_groups = group_managers(ptr_list, size, group);
+        for (size_t n = 0; n < num_groups; ++n) {
+                // Only the release of the last chunk may find the last ownership gone
+                for (size_t count = group[n].count; count > 0;) {
+                        const int chunk = group_chunk(count);
+                        count -= chunk;
+
+                        AUTOPTR_STATS_COUNT(group[n].manager, AUTOPTR_STATS_UNBIND, chunk);
+                        AUTOPTR_TRACE_EVENT(AUTOPTR_TRACE_UNBIND, group[n].manager, group[n].manager, chunk,
+                                            __builtin_return_address(0));
+                        if (__autoptr_release_last(group[n].manager, chunk))
+                                __autoptr_reclaim(group[n].manager);
+                }
+        }
+
+        for (size_t n = 0; n < size; ++n)
+                ptr_list[n] = NULL;
+
+        free(group);
 }
 
 void autoptr_free_obj(void **ptr)
 {
         assert(*ptr != NULL);
-        autoptr_unbind(ptr);
+#if AUTOPTR_SHARDED
+        // The creator releases its ownership
+        __autoptr_shard_drain(AUTOPTR_M(*ptr));
+#endif
+        unbind(ptr, __builtin_return_address(0));
 }
 
 void autoptr_vfree_obj(void **ptr, size_t size)
@@ -139,8 +631,11 @@ void autoptr_vfree_obj(void **ptr, size_t size)
         // object is the manager and that size is that of the number of managed objects
         AUTOPTR_M_LOCK(*ptr);
         assert(AUTOPTR_M(*ptr) == AUTOPTR(*ptr));
-        assert(AUTOPTR_M(*ptr)->num_managed == size);
+        assert(__autoptr_num_managed(AUTOPTR_M(*ptr)) == size);
         AUTOPTR_M_UNLOCK(*ptr);
 
-        autoptr_unbind(ptr);
+#if AUTOPTR_SHARDED
+        __autoptr_shard_drain(AUTOPTR_M(*ptr));
+#endif
+        unbind(ptr, __builtin_return_address(0));
 }
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2017-2019 Jason Graham <jgraham@compukix.net>
+ *
+ * This file is part of libautoptr.
+ *
+ * libautoptr is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libautoptr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libautoptr.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+/*
+ * Aligned allocations
+ *
+ * Every allocation starts with a prefix of one cache line telling how it was made, so that the object that follows
+ * stays aligned and autoptr_aligned_free needs nothing but the object address. A mapping is made one huge page
+ * longer than needed and trimmed to a huge page boundary at the front and to whole pages at the back.
+ */
+#define _DEFAULT_SOURCE
+
+#include "autoptr_private.h"
+#include <libautoptr/autoptr_aligned.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+struct prefix {
+        size_t map_len; // Length of the mapping; zero for a heap allocation
+} __attribute__((aligned(AUTOPTR_CACHE_LINE)));
+
+static inline struct prefix *prefix(void *ptr)
+{
+        return (struct prefix *)ptr - 1;
+}
+
+static void *map(size_t len)
+{
+        const size_t page_len = (size_t)sysconf(_SC_PAGESIZE);
+        const size_t map_len  = (len + page_len - 1) / page_len * page_len;
+
+        if (map_len < len || map_len + AUTOPTR_HUGE_PAGE < map_len)
+                return NULL;
+
+        char *addr = mmap(NULL, map_len + AUTOPTR_HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                          -1, 0);
+        if (addr == MAP_FAILED)
+                return NULL;
+
+        // Trim to a huge page boundary; anonymous mappings are zeroed
+        char *base        = (char *)(((uintptr_t)addr + AUTOPTR_HUGE_PAGE - 1) & ~(uintptr_t)(AUTOPTR_HUGE_PAGE - 1));
+        const size_t head = (size_t)(base - addr);
+        if (head != 0)
+                munmap(addr, head);
+        munmap(base + map_len, AUTOPTR_HUGE_PAGE - head);
+
+#ifdef MADV_HUGEPAGE
+        madvise(base, map_len, MADV_HUGEPAGE);
+#endif
+        ((struct prefix *)base)->map_len = map_len;
+
+        return base + sizeof(struct prefix);
+}
+
+void *autoptr_aligned_alloc(size_t obj_len)
+{
+        const size_t len = sizeof(struct prefix) + autoptr_aligned_stride(obj_len);
+        void *base;
+
+        if (len < obj_len)
+                return NULL;
+        if (len >= AUTOPTR_ALIGNED_MAP_LEN)
+                return map(len);
+
+        if (posix_memalign(&base, AUTOPTR_CACHE_LINE, len) != 0)
+                return NULL;
+
+        memset(base, 0, len);
+        return (char *)base + sizeof(struct prefix);
+}
+
+void *autoptr_aligned_valloc(size_t obj_len, size_t num_obj)
+{
+        if (num_obj != 0 && obj_len > SIZE_MAX / num_obj)
+                return NULL;
+
+        return autoptr_aligned_alloc(obj_len * num_obj);
+}
+
+void autoptr_aligned_free(void *ptr)
+{
+        if (ptr == NULL)
+                return;
+
+        struct prefix *p = prefix(ptr);
+
+        if (p->map_len != 0)
+                munmap(p, p->map_len);
+        else
+                free(p);
+}
+
+void autoptr_aligned_set_allocd(void *ptr)
+{
+        autoptr_set_allocd(ptr, true);
+
+        AUTOPTR_M_LOCK(ptr);
+#if AUTOPTR_COMPACT
+        AUTOPTR_M(ptr)->flags |= AUTOPTR_F_ALIGNED;
+#else
+        AUTOPTR_M(ptr)->aligned = true;
+#endif
+        AUTOPTR_M_UNLOCK(ptr);
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2017-2019 Jason Graham <jgraham@compukix.net>
+ *
+ * This file is part of libautoptr.
+ *
+ * libautoptr is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libautoptr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libautoptr.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+/*
+ * Biased reference counting
+ *
+ * The number of ownerships of an object (bound references plus the creator) is the sum of the owner-local count
+ * and the shared count. The owner thread adjusts the local count with plain loads and stores; every other thread
+ * adjusts the shared count atomically. Only the owner can read the sum exactly, so until the counts are merged
+ * other threads never conclude that they hold the last reference.
+ *
+ * The counts are merged (the local count added to the shared count and the object flagged as merged):
+ *
+ * - by the owner when its local count drops to zero or on autoptr_biased_merge(), after claiming the merge with
+ *   the queued flag,
+ *
+ * - through the queue of the owner when another thread drives the shared count negative, i.e. releases a
+ *   reference counted by the owner. That thread flags the object as queued and pushes it on the owner queue, which
+ *   the owner drains at its next release, on autoptr_biased_drain() and when it exits.
+ *
+ * The queued flag marks an object whose merge was claimed, so that it is merged exactly once and never destroyed
+ * before.
+ *
+ * Owner records are never freed since objects keep pointing to them after their thread exited.
+ */
+#include "autoptr_private.h"
+
+#if AUTOPTR_BIASED
+
+__thread struct autoptr_brc_owner *__autoptr_brc_self = NULL;
+
+static pthread_key_t owner_key;
+static pthread_once_t owner_key_once = PTHREAD_ONCE_INIT;
+
+static void owner_exit(void *arg)
+{
+        struct autoptr_brc_owner *owner = arg;
+
+        // Objects released from here on take the shared count path
+        __autoptr_brc_self = NULL;
+
+        // Pushes from here on are merged by the pushing thread; this drain takes whatever was pushed before
+        atomic_store_explicit(&owner->exited, true, memory_order_seq_cst);
+        __autoptr_brc_drain(owner);
+}
+
+static void owner_key_create(void)
+{
+        pthread_key_create(&owner_key, owner_exit);
+}
+
+struct autoptr_brc_owner *__autoptr_brc_register(void)
+{
+        if (__autoptr_brc_self != NULL)
+                return __autoptr_brc_self;
+
+        struct autoptr_brc_owner *owner = malloc(sizeof(*owner));
+        if (owner == NULL)
+                return NULL;
+
+        atomic_init(&owner->queue, NULL);
+        atomic_init(&owner->exited, false);
+
+        pthread_once(&owner_key_once, owner_key_create);
+        pthread_setspecific(owner_key, owner);
+
+        return __autoptr_brc_self = owner;
+}
+
+/*
+ * Merges the local count into the shared count. The caller holds the queued flag, so no other thread merges or
+ * queues the object meanwhile. The owner fields are reset before the counts are published as merged since another
+ * thread may destroy the object as soon as they are.
+ */
+static void merge(struct autoptr *manager)
+{
+        const int local = __atomic_load_n(&manager->brc_local, __ATOMIC_RELAXED);
+
+        __atomic_store_n(&manager->brc_local, 0, __ATOMIC_RELAXED);
+        atomic_store_explicit(&manager->brc_owner, NULL, memory_order_relaxed);
+
+        const int shared = atomic_fetch_add_explicit(&manager->r_count, local * AUTOPTR_BRC_ONE + AUTOPTR_BRC_MERGED,
+                                                     memory_order_acq_rel);
+
+        // Every ownership was already released
+        if (__autoptr_brc_count(shared) + local == 0)
+                __autoptr_reclaim(manager);
+}
+
+void __autoptr_brc_drop(struct autoptr *manager)
+{
+        // Claim the merge; an object already queued by another thread is merged through the queue
+        const int shared = atomic_fetch_or_explicit(&manager->r_count, AUTOPTR_BRC_QUEUED, memory_order_relaxed);
+        if (shared & AUTOPTR_BRC_QUEUED) {
+                __autoptr_brc_drain(__autoptr_brc_self);
+                return;
+        }
+
+        merge(manager);
+}
+
+void __autoptr_brc_queue(struct autoptr *manager)
+{
+        // The caller set the queued flag, so the owner neither merges nor destroys the object until it is drained
+        struct autoptr_brc_owner *owner = atomic_load_explicit(&manager->brc_owner, memory_order_relaxed);
+        assert(owner != NULL);
+
+        struct autoptr *head = atomic_load_explicit(&owner->queue, memory_order_relaxed);
+        do {
+                manager->brc_next = head;
+        } while (!atomic_compare_exchange_weak_explicit(&owner->queue, &head, manager, memory_order_seq_cst,
+                                                        memory_order_relaxed));
+
+        // The owner exited and will not drain again; merge on its behalf (its local counts are final)
+        if (atomic_load_explicit(&owner->exited, memory_order_seq_cst))
+                __autoptr_brc_drain(owner);
+}
+
+void __autoptr_brc_drain(struct autoptr_brc_owner *owner)
+{
+        struct autoptr *manager = atomic_exchange_explicit(&owner->queue, NULL, memory_order_seq_cst);
+
+        while (manager != NULL) {
+                // The object may be destroyed by the merge
+                struct autoptr *next = manager->brc_next;
+                merge(manager);
+                manager = next;
+        }
+}
+
+void autoptr_biased_merge(void *ptr)
+{
+        autoptr_assert(ptr);
+
+        if (__autoptr_brc_owned(AUTOPTR_M(ptr)))
+                __autoptr_brc_drop(AUTOPTR_M(ptr));
+}
+
+void autoptr_biased_drain(void)
+{
+        if (__autoptr_brc_self != NULL)
+                __autoptr_brc_drain(__autoptr_brc_self);
+}
+
+#endif // AUTOPTR_BIASED
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2017-2019 Jason Graham <jgraham@compukix.net>
+ *
+ * This file is part of libautoptr.
+ *
+ * libautoptr is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libautoptr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libautoptr.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+/*
+ * Channels
+ *
+ * A ring of cells, each with a sequence number telling which lap of the ring may use it next: a cell at position
+ * pos is free for the sender of pos when its sequence is pos, and holds the reference for the receiver of pos
+ * once its sequence is pos + 1. Senders and receivers claim positions by advancing their counter with a
+ * compare-and-swap after checking the sequence of the cell; the sequence is then published with release
+ * ordering, so the reference stored in a cell is visible to the thread that claims it next. The counters are kept
+ * on cache lines of their own.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "autoptr_private.h"
+#include <libautoptr/autoptr_aligned.h>
+#include <libautoptr/autoptr_channel.h>
+#include <stdint.h>
+
+struct cell {
+        size_t seq;
+        void *ptr;
+};
+
+struct autoptr_channel {
+        struct cell *cells;
+        size_t mask;
+        size_t send_pos __attribute__((aligned(AUTOPTR_CACHE_LINE))); ///< Next position to send to
+        size_t recv_pos __attribute__((aligned(AUTOPTR_CACHE_LINE))); ///< Next position to receive from
+};
+
+struct autoptr_channel *autoptr_channel_create(size_t capacity)
+{
+        struct autoptr_channel *ch;
+        size_t len = 2;
+
+        // The rounded up length must neither wrap nor overflow the size of the ring
+        if (capacity > SIZE_MAX / 2 / sizeof(*ch->cells))
+                return NULL;
+        while (len < capacity)
+                len *= 2;
+
+        if (posix_memalign((void **)&ch, AUTOPTR_CACHE_LINE, sizeof(*ch)) != 0)
+                return NULL;
+
+        ch->cells = malloc(len * sizeof(*ch->cells));
+        if (ch->cells == NULL) {
+                free(ch);
+                return NULL;
+        }
+        for (size_t n = 0; n < len; ++n) {
+                ch->cells[n].seq = n;
+                ch->cells[n].ptr = NULL;
+        }
+        ch->mask     = len - 1;
+        ch->send_pos = 0;
+        ch->recv_pos = 0;
+
+        return ch;
+}
+
+void autoptr_channel_destroy(struct autoptr_channel *ch)
+{
+        void *ptr;
+
+        while ((ptr = autoptr_channel_recv(ch)) != NULL)
+                autoptr_unbind(&ptr);
+
+        free(ch->cells);
+        free(ch);
+}
+
+bool autoptr_channel_send(struct autoptr_channel *ch, void **ptr)
+{
+        assert(*ptr != NULL);
+
+        size_t pos = __atomic_load_n(&ch->send_pos, __ATOMIC_RELAXED);
+        struct cell *cell;
+
+        for (;;) {
+                cell                = &ch->cells[pos & ch->mask];
+                const intptr_t diff = (intptr_t)__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) - (intptr_t)pos;
+
+                if (diff == 0) {
+                        if (__atomic_compare_exchange_n(&ch->send_pos, &pos, pos + 1, true, __ATOMIC_RELAXED,
+                                                        __ATOMIC_RELAXED))
+                                break;
+                } else if (diff < 0) {
+                        // The receiver of the previous lap has not taken the cell yet
+                        return false;
+                } else {
+                        pos = __atomic_load_n(&ch->send_pos, __ATOMIC_RELAXED);
+                }
+        }
+
+        cell->ptr = autoptr_move(ptr);
+        __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+        return true;
+}
+
+void *autoptr_channel_recv(struct autoptr_channel *ch)
+{
+        size_t pos = __atomic_load_n(&ch->recv_pos, __ATOMIC_RELAXED);
+        struct cell *cell;
+
+        for (;;) {
+                cell                = &ch->cells[pos & ch->mask];
+                const intptr_t diff = (intptr_t)__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) - (intptr_t)(pos + 1);
+
+                if (diff == 0) {
+                        if (__atomic_compare_exchange_n(&ch->recv_pos, &pos, pos + 1, true, __ATOMIC_RELAXED,
+                                                        __ATOMIC_RELAXED))
+                                break;
+                } else if (diff < 0) {
+                        // The sender of this position has not stored its reference yet
+                        return NULL;
+                } else {
+                        pos = __atomic_load_n(&ch->recv_pos, __ATOMIC_RELAXED);
+                }
+        }
+
+        void *ptr = autoptr_move(&cell->ptr);
+        __atomic_store_n(&cell->seq, pos + ch->mask + 1, __ATOMIC_RELEASE);
+        return ptr;
+}
+
+size_t autoptr_channel_capacity(const struct autoptr_channel *ch)
+{
+        return ch->mask + 1;
+}
@@ -0,0 +1,339 @@
+/*
+ * Copyright (c) 2017-2019 Jason Graham <jgraham@compukix.net>
+ *
+ * This file is part of libautoptr.
+ *
+ * libautoptr is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libautoptr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libautoptr.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+/*
+ * Epochs
+ *
+ * A thread entering an epoch announces the global epoch in its record. The global epoch advances only when every
+ * thread inside an epoch has announced its current value. A set is retired with the global epoch read after its
+ * last reference was released, and destroyed once the global epoch is two past it: every thread that entered its
+ * epoch before the set was unlinked from the shared location has left it by then. The announcements and the reads
+ * of the global epoch are ordered by sequentially consistent fences, so that a reader either holds back the advance
+ * or loads the shared location after the set was unlinked.
+ *
+ * The records are linked in a registry and never freed. When a thread exits its record is put on a free list,
+ * with the sets it retired, and taken over by the next thread that registers. The retired sets of a record are
+ * guarded by its mutex, so that any thread may destroy those whose grace period has ended.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "autoptr_private.h"
+#include <libautoptr/autoptr_aligned.h>
+#include <libautoptr/autoptr_epoch.h>
+#include <libautoptr/autoptr_reclaim.h>
+#include <sched.h>
+#include <stdint.h>
+#include <string.h>
+
+#define ACTIVE 1UL // Flag of the state of a record inside an epoch
+
+struct retired {
+        struct autoptr *manager;
+        unsigned long epoch; ///< Global epoch when the set was retired
+};
+
+struct record {
+        unsigned long state;     ///< Announced epoch shifted left by one, flagged ACTIVE; 0 outside of epochs
+        unsigned int nesting;    ///< Depth of nested epochs (owner thread only)
+        pthread_mutex_t mutex;   ///< Guards the retired sets
+        struct retired *retired; ///< Retired sets
+        size_t num_retired;
+        size_t max_retired;
+        struct record *next;      ///< Next record of the registry
+        struct record *next_free; ///< Next record of the free list
+} __attribute__((aligned(AUTOPTR_CACHE_LINE)));
+
+static __thread struct record *self __attribute__((tls_model("initial-exec"))) = NULL;
+
+static unsigned long global_epoch __attribute__((aligned(AUTOPTR_CACHE_LINE))) = 1;
+
+static bool enabled     = false;
+static size_t in_flight = 0; ///< Number of unbinds between the enabled test and the retire
+
+static pthread_mutex_t epoch_mutex    = PTHREAD_MUTEX_INITIALIZER; ///< Serializes start and stop
+static pthread_mutex_t registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct record *registry        = NULL;
+static struct record *free_records    = NULL; // Records of exited threads (registry mutex held)
+
+static pthread_key_t record_key;
+static pthread_once_t record_key_once = PTHREAD_ONCE_INIT;
+
+static void record_exit(void *arg)
+{
+        struct record *rec = arg;
+
+        // An exiting thread leaves the epochs it did not
+        rec->nesting = 0;
+        __atomic_store_n(&rec->state, 0, __ATOMIC_RELEASE);
+
+        pthread_mutex_lock(&registry_mutex);
+        rec->next_free = free_records;
+        free_records   = rec;
+        pthread_mutex_unlock(&registry_mutex);
+
+        // Destructors of other keys may still unbind; they take a record again
+        self = NULL;
+}
+
+static void record_key_create(void)
+{
+        pthread_key_create(&record_key, record_exit);
+}
+
+static struct record *record_register(void)
+{
+        struct record *rec;
+
+        pthread_once(&record_key_once, record_key_create);
+
+        pthread_mutex_lock(&registry_mutex);
+        if ((rec = free_records) != NULL) {
+                free_records = rec->next_free;
+        } else if (posix_memalign((void **)&rec, AUTOPTR_CACHE_LINE, sizeof(*rec)) == 0) {
+                memset(rec, 0, sizeof(*rec));
+                pthread_mutex_init(&rec->mutex, NULL);
+                rec->next = registry;
+                __atomic_store_n(&registry, rec, __ATOMIC_RELEASE);
+        } else {
+                rec = NULL;
+        }
+        pthread_mutex_unlock(&registry_mutex);
+
+        if (rec != NULL)
+                pthread_setspecific(record_key, rec);
+        return self = rec;
+}
+
+/*
+ * Advances the global epoch if every thread inside an epoch has announced it; returns the global epoch
+ */
+static unsigned long advance(void)
+{
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        unsigned long epoch = __atomic_load_n(&global_epoch, __ATOMIC_SEQ_CST);
+
+        for (struct record *rec = __atomic_load_n(&registry, __ATOMIC_ACQUIRE); rec != NULL; rec = rec->next) {
+                const unsigned long state = __atomic_load_n(&rec->state, __ATOMIC_SEQ_CST);
+
+                if ((state & ACTIVE) && (state >> 1) != epoch)
+                        return epoch;
+        }
+
+        if (__atomic_compare_exchange_n(&global_epoch, &epoch, epoch + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+                ++epoch;
+        return epoch;
+}
+
+/*
+ * Waits until every thread inside an epoch has left it; the calling thread may not be inside one
+ */
+static void synchronize(void)
+{
+        assert(self == NULL || self->nesting == 0);
+
+        const unsigned long epoch = advance();
+        while (advance() - epoch < 2)
+                sched_yield();
+}
+
+static void destroy(struct autoptr *manager)
+{
+        if (!__autoptr_reclaim_defer(manager))
+                __autoptr_destroy(manager);
+}
+
+/*
+ * Destroys the retired sets of a record whose grace period ended by the global epoch; returns the number destroyed
+ */
+static size_t collect(struct record *rec, unsigned long epoch)
+{
+        size_t num_destroyed = 0;
+        size_t n             = SIZE_MAX;
+
+        // The mutex is not held by the destructors, which may retire sets to the record in turn. Sets are only
+        // appended meanwhile and taken out by moving the last one in their place, so the sets after n were seen.
+        for (;;) {
+                struct autoptr *manager = NULL;
+
+                pthread_mutex_lock(&rec->mutex);
+                if (n > rec->num_retired)
+                        n = rec->num_retired;
+                while (n > 0) {
+                        const struct retired *retired = &rec->retired[--n];
+
+                        if (epoch - retired->epoch >= 2) {
+                                manager         = retired->manager;
+                                rec->retired[n] = rec->retired[--rec->num_retired];
+                                break;
+                        }
+                }
+                pthread_mutex_unlock(&rec->mutex);
+
+                if (manager == NULL)
+                        break;
+
+                destroy(manager);
+                ++num_destroyed;
+        }
+        return num_destroyed;
+}
+
+/*
+ * Adds a set to the retired sets of the calling thread; returns false if it has to be destroyed by the caller
+ */
+static bool retire(struct autoptr *manager)
+{
+        struct record *rec = self;
+        if (rec == NULL && (rec = record_register()) == NULL) {
+                // Not inside an epoch; the set is destroyed once no thread may borrow it any longer
+                synchronize();
+                return false;
+        }
+
+        // Read after the last reference was released and the set unlinked by the caller
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        const unsigned long epoch = __atomic_load_n(&global_epoch, __ATOMIC_SEQ_CST);
+
+        pthread_mutex_lock(&rec->mutex);
+        if (rec->num_retired == rec->max_retired) {
+                const size_t max_retired = rec->max_retired ? 2 * rec->max_retired : AUTOPTR_EPOCH_BATCH;
+                struct retired *retired  = realloc(rec->retired, max_retired * sizeof(*retired));
+
+                if (retired == NULL) {
+                        pthread_mutex_unlock(&rec->mutex);
+                        if (rec->nesting != 0) {
+                                fprintf(stderr, "autoptr_unbind: cannot retire %p inside an epoch\n", (void *)manager);
+                                abort();
+                        }
+                        synchronize();
+                        return false;
+                }
+                rec->retired     = retired;
+                rec->max_retired = max_retired;
+        }
+        rec->retired[rec->num_retired++] = (struct retired){manager, epoch};
+        const size_t num_retired         = rec->num_retired;
+        pthread_mutex_unlock(&rec->mutex);
+
+        if (num_retired % AUTOPTR_EPOCH_BATCH == 0)
+                collect(rec, advance());
+
+        return true;
+}
+
+bool __autoptr_epoch_defer(struct autoptr *manager)
+{
+        if (!__atomic_load_n(&enabled, __ATOMIC_RELAXED))
+                return false;
+
+        // Announce the retire so that autoptr_epoch_stop() can wait for it before the final collection
+        __atomic_add_fetch(&in_flight, 1, __ATOMIC_SEQ_CST);
+
+        const bool deferred = __atomic_load_n(&enabled, __ATOMIC_SEQ_CST) && retire(manager);
+
+        __atomic_sub_fetch(&in_flight, 1, __ATOMIC_RELEASE);
+
+        return deferred;
+}
+
+int autoptr_epoch_start(void)
+{
+        int ret = -1;
+
+        pthread_mutex_lock(&epoch_mutex);
+        if (!enabled) {
+                __atomic_store_n(&enabled, true, __ATOMIC_SEQ_CST);
+                ret = 0;
+        }
+        pthread_mutex_unlock(&epoch_mutex);
+
+        return ret;
+}
+
+void autoptr_epoch_stop(void)
+{
+        pthread_mutex_lock(&epoch_mutex);
+
+        if (!enabled)
+                goto finish;
+
+        __atomic_store_n(&enabled, false, __ATOMIC_SEQ_CST);
+
+        // Unbinds that saw epochs started finish their retire
+        while (__atomic_load_n(&in_flight, __ATOMIC_ACQUIRE) != 0)
+                sched_yield();
+
+        assert(self == NULL || self->nesting == 0);
+        while (autoptr_epoch_pending() != 0) {
+                if (autoptr_epoch_collect() == 0)
+                        sched_yield();
+        }
+finish:
+        pthread_mutex_unlock(&epoch_mutex);
+}
+
+void autoptr_epoch_enter(void)
+{
+        struct record *rec = self;
+        if (rec == NULL && (rec = record_register()) == NULL) {
+                fprintf(stderr, "autoptr_epoch_enter: cannot register thread\n");
+                exit(EXIT_FAILURE);
+        }
+
+        if (rec->nesting++ != 0)
+                return;
+
+        const unsigned long epoch = __atomic_load_n(&global_epoch, __ATOMIC_RELAXED);
+        __atomic_store_n(&rec->state, epoch << 1 | ACTIVE, __ATOMIC_RELAXED);
+
+        // The announcement precedes the loads of the borrows
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void autoptr_epoch_exit(void)
+{
+        struct record *rec = self;
+        assert(rec != NULL && rec->nesting > 0);
+
+        if (--rec->nesting == 0)
+                __atomic_store_n(&rec->state, 0, __ATOMIC_RELEASE);
+}
+
+size_t autoptr_epoch_collect(void)
+{
+        const unsigned long epoch = advance();
+        size_t num_destroyed      = 0;
+
+        for (struct record *rec = __atomic_load_n(&registry, __ATOMIC_ACQUIRE); rec != NULL; rec = rec->next)
+                num_destroyed += collect(rec, epoch);
+
+        return num_destroyed;
+}
+
+size_t autoptr_epoch_pending(void)
+{
+        size_t num_pending = 0;
+
+        for (struct record *rec = __atomic_load_n(&registry, __ATOMIC_ACQUIRE); rec != NULL; rec = rec->next) {
+                pthread_mutex_lock(&rec->mutex);
+                num_pending += rec->num_retired;
+                pthread_mutex_unlock(&rec->mutex);
+        }
+        return num_pending;
+}
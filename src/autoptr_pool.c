@@ -0,0 +1,340 @@
+/*
+ * Copyright (c) 2017-2019 Jason Graham <jgraham@compukix.net>
+ *
+ * This file is part of libautoptr.
+ *
+ * libautoptr is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libautoptr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libautoptr.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "autoptr_private.h"
+#include <libautoptr/autoptr_pool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define OBJ_ALIGN 16
+#define NUM_POOLS (AUTOPTR_POOL_MAX_OBJ_LEN / OBJ_ALIGN)
+#define SLAB_HEADER_LEN 64 // Keeps the first object on its own cache line
+
+/*
+ * Free objects are kept in magazines (fixed-size stacks). Each thread holds a loaded and a previous magazine per
+ * pool and only goes to the pool depot, under the pool mutex, when both are exhausted (allocation) or both are
+ * full (release). The previous magazine is always either full or empty.
+ */
+struct magazine {
+        struct magazine *next;
+        size_t count;
+        void *obj[AUTOPTR_POOL_MAGAZINE_LEN];
+};
+
+struct magazine_cache {
+        struct magazine *loaded;
+        struct magazine *previous;
+};
+
+struct free_obj {
+        struct free_obj *next;
+};
+
+struct slab {
+        struct autoptr_pool *pool;
+        struct slab *next;
+};
+
+struct autoptr_pool {
+        size_t obj_len; ///< Object stride in bytes
+        size_t index;   ///< Index of the pool in the pool table
+        pthread_mutex_t mutex;
+        struct magazine *full;  ///< Depot of full magazines
+        struct magazine *empty; ///< Depot of empty magazines
+        struct free_obj *free;  ///< Free objects not held by a magazine
+        struct slab *slabs;
+};
+
+static struct autoptr_pool *pools[NUM_POOLS];
+static pthread_mutex_t pools_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_key_t cache_key;
+static pthread_once_t cache_key_once = PTHREAD_ONCE_INIT;
+static __thread struct magazine_cache thread_cache[NUM_POOLS];
+static __thread bool thread_cache_registered = false;
+
+static struct magazine *magazine_alloc(void)
+{
+        struct magazine *mag = malloc(sizeof(*mag));
+        if (mag != NULL) {
+                mag->next  = NULL;
+                mag->count = 0;
+        }
+        return mag;
+}
+
+static inline void push_magazine(struct magazine **depot, struct magazine *mag)
+{
+        mag->next = *depot;
+        *depot    = mag;
+}
+
+static inline struct magazine *pop_magazine(struct magazine **depot)
+{
+        struct magazine *mag = *depot;
+        if (mag != NULL)
+                *depot = mag->next;
+        return mag;
+}
+
+/*
+ * Returns a thread magazine to the depot (pool mutex held)
+ */
+static void return_magazine(struct autoptr_pool *pool, struct magazine *mag)
+{
+        if (mag->count == AUTOPTR_POOL_MAGAZINE_LEN) {
+                push_magazine(&pool->full, mag);
+                return;
+        }
+
+        // Partially filled magazines give their objects back to the free list
+        while (mag->count > 0) {
+                struct free_obj *obj = mag->obj[--mag->count];
+                obj->next            = pool->free;
+                pool->free           = obj;
+        }
+        push_magazine(&pool->empty, mag);
+}
+
+static void thread_cache_flush(void *arg)
+{
+        struct magazine_cache *cache = arg;
+
+        for (size_t n = 0; n < NUM_POOLS; ++n) {
+                if (cache[n].loaded == NULL)
+                        continue;
+
+                struct autoptr_pool *pool = pools[n];
+
+                pthread_mutex_lock(&pool->mutex);
+                return_magazine(pool, cache[n].loaded);
+                return_magazine(pool, cache[n].previous);
+                pthread_mutex_unlock(&pool->mutex);
+
+                cache[n].loaded   = NULL;
+                cache[n].previous = NULL;
+        }
+
+        // Destructors of other keys may still allocate or free; the magazines they take are registered anew
+        thread_cache_registered = false;
+}
+
+static void cache_key_create(void)
+{
+        pthread_key_create(&cache_key, thread_cache_flush);
+}
+
+/*
+ * Returns the calling thread's magazines for a pool; NULL if they could not be allocated
+ */
+static struct magazine_cache *thread_cache_get(struct autoptr_pool *pool)
+{
+        struct magazine_cache *cache = &thread_cache[pool->index];
+
+        if (cache->loaded != NULL)
+                return cache;
+
+        if (!thread_cache_registered) {
+                // Flushes the magazines back to the depots when the thread exits
+                pthread_once(&cache_key_once, cache_key_create);
+                pthread_setspecific(cache_key, thread_cache);
+                thread_cache_registered = true;
+        }
+
+        struct magazine *loaded   = magazine_alloc();
+        struct magazine *previous = magazine_alloc();
+        if (loaded == NULL || previous == NULL) {
+                free(loaded);
+                free(previous);
+                return NULL;
+        }
+
+        cache->loaded   = loaded;
+        cache->previous = previous;
+        return cache;
+}
+
+/*
+ * Carves a new slab into the free list (pool mutex held)
+ */
+static bool slab_alloc(struct autoptr_pool *pool)
+{
+        void *mem;
+        if (posix_memalign(&mem, AUTOPTR_POOL_SLAB_LEN, AUTOPTR_POOL_SLAB_LEN) != 0)
+                return false;
+
+        struct slab *slab = mem;
+        slab->pool        = pool;
+        slab->next        = pool->slabs;
+        pool->slabs       = slab;
+
+        const size_t num_obj = (AUTOPTR_POOL_SLAB_LEN - SLAB_HEADER_LEN) / pool->obj_len;
+
+        // Link in reverse so that objects are handed out in address order
+        for (size_t n = num_obj; n > 0; --n) {
+                struct free_obj *obj = (struct free_obj *)((char *)mem + SLAB_HEADER_LEN + pool->obj_len * (n - 1));
+                obj->next            = pool->free;
+                pool->free           = obj;
+        }
+        return true;
+}
+
+struct autoptr_pool *autoptr_pool_get(size_t obj_len)
+{
+        if (obj_len == 0 || obj_len > AUTOPTR_POOL_MAX_OBJ_LEN)
+                return NULL;
+
+        const size_t index        = (obj_len + OBJ_ALIGN - 1) / OBJ_ALIGN - 1;
+        struct autoptr_pool *pool = __atomic_load_n(&pools[index], __ATOMIC_ACQUIRE);
+
+        if (pool != NULL)
+                return pool;
+
+        pthread_mutex_lock(&pools_mutex);
+        pool = pools[index];
+        if (pool == NULL) {
+                pool = calloc(1, sizeof(*pool));
+                if (pool != NULL) {
+                        pool->obj_len = (index + 1) * OBJ_ALIGN;
+                        pool->index   = index;
+                        pthread_mutex_init(&pool->mutex, NULL);
+                        __atomic_store_n(&pools[index], pool, __ATOMIC_RELEASE);
+                }
+        }
+        pthread_mutex_unlock(&pools_mutex);
+
+        return pool;
+}
+
+void *autoptr_pool_alloc(struct autoptr_pool *pool)
+{
+        if (pool == NULL)
+                return NULL;
+
+        void *obj                    = NULL;
+        struct magazine_cache *cache = thread_cache_get(pool);
+
+        if (cache == NULL) {
+                // No magazines; allocate from the free list directly
+                pthread_mutex_lock(&pool->mutex);
+                if (pool->free != NULL || slab_alloc(pool)) {
+                        obj        = pool->free;
+                        pool->free = pool->free->next;
+                }
+                pthread_mutex_unlock(&pool->mutex);
+                goto finish;
+        }
+
+        if (cache->loaded->count == 0) {
+                if (cache->previous->count > 0) {
+                        struct magazine *mag = cache->loaded;
+                        cache->loaded        = cache->previous;
+                        cache->previous      = mag;
+                } else {
+                        pthread_mutex_lock(&pool->mutex);
+                        struct magazine *full = pop_magazine(&pool->full);
+                        if (full != NULL) {
+                                push_magazine(&pool->empty, cache->previous);
+                                cache->previous = cache->loaded;
+                                cache->loaded   = full;
+                        } else {
+                                // Fill the loaded magazine from the free list
+                                struct magazine *mag = cache->loaded;
+                                while (mag->count < AUTOPTR_POOL_MAGAZINE_LEN &&
+                                       (pool->free != NULL || slab_alloc(pool))) {
+                                        mag->obj[mag->count++] = pool->free;
+                                        pool->free             = pool->free->next;
+                                }
+                        }
+                        pthread_mutex_unlock(&pool->mutex);
+
+                        if (cache->loaded->count == 0)
+                                return NULL;
+                }
+        }
+
+        obj = cache->loaded->obj[--cache->loaded->count];
+finish:
+        if (obj != NULL)
+                memset(obj, 0, pool->obj_len);
+        return obj;
+}
+
+void autoptr_pool_free(void *ptr)
+{
+        assert(ptr != NULL);
+
+        struct slab *slab            = (struct slab *)((uintptr_t)ptr & ~(uintptr_t)(AUTOPTR_POOL_SLAB_LEN - 1));
+        struct autoptr_pool *pool    = slab->pool;
+        struct magazine_cache *cache = thread_cache_get(pool);
+
+        if (cache != NULL && cache->loaded->count == AUTOPTR_POOL_MAGAZINE_LEN) {
+                if (cache->previous->count == 0) {
+                        struct magazine *mag = cache->loaded;
+                        cache->loaded        = cache->previous;
+                        cache->previous      = mag;
+                } else {
+                        pthread_mutex_lock(&pool->mutex);
+                        struct magazine *empty = pop_magazine(&pool->empty);
+                        if (empty != NULL)
+                                push_magazine(&pool->full, cache->previous);
+                        pthread_mutex_unlock(&pool->mutex);
+
+                        if (empty == NULL && (empty = magazine_alloc()) != NULL) {
+                                pthread_mutex_lock(&pool->mutex);
+                                push_magazine(&pool->full, cache->previous);
+                                pthread_mutex_unlock(&pool->mutex);
+                        }
+
+                        if (empty != NULL) {
+                                cache->previous = cache->loaded;
+                                cache->loaded   = empty;
+                        } else {
+                                cache = NULL;
+                        }
+                }
+        }
+
+        if (cache == NULL) {
+                // No magazine space; return the object to the free list directly
+                pthread_mutex_lock(&pool->mutex);
+                ((struct free_obj *)ptr)->next = pool->free;
+                pool->free                     = ptr;
+                pthread_mutex_unlock(&pool->mutex);
+                return;
+        }
+
+        cache->loaded->obj[cache->loaded->count++] = ptr;
+}
+
+void autoptr_pool_set_allocd(void *ptr)
+{
+        autoptr_set_allocd(ptr, true);
+
+        AUTOPTR_M_LOCK(ptr);
+#if AUTOPTR_COMPACT
+        AUTOPTR_M(ptr)->flags |= AUTOPTR_F_POOLED;
+#else
+        AUTOPTR_M(ptr)->pooled = true;
+#endif
+        AUTOPTR_M_UNLOCK(ptr);
+}
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2017-2019 Jason Graham <jgraham@compukix.net>
+ *
+ * This file is part of libautoptr.
+ *
+ * libautoptr is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libautoptr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libautoptr.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+/*
+ * Definitions shared by the library sources (not installed)
+ */
+#ifndef __AUTOPTR_PRIVATE_H__
+#define __AUTOPTR_PRIVATE_H__
+
+#include <libautoptr/autoptr.h>
+
+#define AUTOPTR(a) ((struct autoptr *)(a))
+#define AUTOPTR_M(a) (AUTOPTR(a)->manager)
+
+#if AUTOPTR_HEADER_LOCK
+#define AUTOPTR_LOCK(a) (__autoptr_lock(AUTOPTR(a)))
+#define AUTOPTR_UNLOCK(a) (__autoptr_unlock(AUTOPTR(a)))
+
+#define AUTOPTR_M_LOCK(a) (__autoptr_lock(AUTOPTR_M(a)))
+#define AUTOPTR_M_UNLOCK(a) (__autoptr_unlock(AUTOPTR_M(a)))
+#else
+#define AUTOPTR_LOCK(a)
+#define AUTOPTR_UNLOCK(a)
+#define AUTOPTR_M_LOCK(a)
+#define AUTOPTR_M_UNLOCK(a)
+#endif
+
+/*
+ * Initializes and destroys the lock of an object header
+ */
+static inline void __autoptr_lock_init(struct autoptr *a)
+{
+#if AUTOPTR_COMPACT
+        (void)a;
+#elif AUTOPTR_LOCKING == AUTOPTR_LOCKING_MUTEX
+        const int ret = pthread_mutex_init(&a->mutex, NULL);
+        assert(ret == 0);
+        (void)ret;
+#elif AUTOPTR_LOCKING == AUTOPTR_LOCKING_SPIN
+        a->spin = 0;
+#else
+        (void)a;
+#endif
+}
+
+static inline void __autoptr_lock_destroy(struct autoptr *a)
+{
+#if !AUTOPTR_COMPACT && AUTOPTR_LOCKING == AUTOPTR_LOCKING_MUTEX
+        pthread_mutex_destroy(&a->mutex);
+#else
+        (void)a;
+#endif
+}
+
+/*
+ * Destroys all objects of a managed set and frees it if heap-allocated. The reference count of the manager must
+ * be zero.
+ */
+void __autoptr_destroy(struct autoptr *manager);
+
+/*
+ * Manager of the set whose objects the calling thread is destroying; NULL outside of the destructors
+ */
+extern __thread struct autoptr *__autoptr_destroying __attribute__((tls_model("initial-exec")));
+
+/*
+ * Storage of a managed set, taken from the manager before its header is torn down
+ */
+struct autoptr_storage {
+        bool allocd;
+        bool pooled;
+        bool aligned;
+        bool regional;
+        const struct autoptr_allocator *allocator;
+        size_t len; // Length in bytes of all objects of the set
+};
+
+static inline struct autoptr_storage __autoptr_storage(const struct autoptr *manager)
+{
+        return (struct autoptr_storage){
+            .allocd    = __autoptr_allocd(manager),
+            .pooled    = __autoptr_pooled(manager),
+            .aligned   = __autoptr_aligned(manager),
+            .regional  = __autoptr_regional(manager),
+            .allocator = __autoptr_allocator(manager),
+            .len       = __autoptr_obj_len(manager) * __autoptr_num_managed(manager),
+        };
+}
+
+/*
+ * Frees the storage of a managed set if heap-allocated (with its allocator if any, to its pool if pooled, with
+ * autoptr_aligned_free if aligned) or gives it back to its region
+ */
+void __autoptr_free(struct autoptr *manager, const struct autoptr_storage *storage);
+
+/*
+ * Gives the storage of a destroyed managed set back to its region (see autoptr_region.h)
+ */
+void __autoptr_region_release(struct autoptr *manager);
+
+/*
+ * Destroys the objects of a managed set other than the manager on the teardown workers and the calling thread.
+ * Returns false, having destroyed nothing, if the set is not torn down in parallel.
+ */
+bool __autoptr_teardown(struct autoptr *manager);
+
+/*
+ * Releases n references of a managed set. Returns true if the references were the last ones, in which case the
+ * reference count is left at zero and the caller must destroy the managed set (see __autoptr_reclaim).
+ */
+bool __autoptr_release_last(struct autoptr *manager, int n);
+
+/*
+ * Destroys a managed set whose last reference was released, unless its destruction is deferred
+ */
+void __autoptr_reclaim(struct autoptr *manager);
+
+#if AUTOPTR_WEAK
+/*
+ * Called with the last reference of a managed set before destroying it. Marks a set that has weak references as
+ * expired and returns true; returns false if weak references were upgraded meanwhile, in which case the caller's
+ * reference was released instead.
+ */
+bool __autoptr_expire(struct autoptr *manager);
+
+/*
+ * Tests if a managed set with weak references was destroyed
+ */
+bool __autoptr_expired(struct autoptr *manager);
+
+/*
+ * Drops the weak count held by the bound references of an expired set once its objects are destroyed. Frees the
+ * storage if no weak reference is left.
+ */
+void __autoptr_expired_release(struct autoptr *manager);
+#endif
+
+#if AUTOPTR_BIASED
+/*
+ * Returns the biased reference counting record of the calling thread, creating it on first use; NULL if it could
+ * not be allocated
+ */
+struct autoptr_brc_owner *__autoptr_brc_register(void);
+#endif
+
+/*
+ * Queues a heap-allocated managed set whose last reference was released for deferred destruction. Returns false if
+ * deferred reclaim is disabled or the queue is full, in which case the caller destroys the set.
+ */
+bool __autoptr_reclaim_defer(struct autoptr *manager);
+
+/*
+ * Retires a heap-allocated managed set whose last reference was released until the threads inside an epoch have
+ * left it. Returns false if epochs are not started, in which case the caller destroys the set.
+ */
+bool __autoptr_epoch_defer(struct autoptr *manager);
+
+#endif // __AUTOPTR_PRIVATE_H__
@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2017-2019 Jason Graham <jgraham@compukix.net>
+ *
+ * This file is part of libautoptr.
+ *
+ * libautoptr is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libautoptr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libautoptr.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "autoptr_private.h"
+#include <errno.h>
+#include <libautoptr/autoptr_reclaim.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ * Bounded MPMC queue of managers (D. Vyukov). Each cell carries a sequence number telling producers and consumers
+ * whose turn it is, so that pushes and pops only contend on their own position counter.
+ */
+struct cell {
+        size_t seq;
+        struct autoptr *manager;
+};
+
+static struct cell *queue = NULL;
+static size_t queue_mask  = 0;
+static size_t enqueue_pos __attribute__((aligned(64))) = 0;
+static size_t dequeue_pos __attribute__((aligned(64))) = 0;
+
+static bool enabled    = false;
+static bool background = false;
+static size_t in_flight = 0; ///< Number of unbinds between the enabled test and the push
+
+static pthread_mutex_t reclaim_mutex = PTHREAD_MUTEX_INITIALIZER; ///< Serializes start and stop
+static pthread_t reclaimer;
+static sem_t reclaimer_sem;
+static bool reclaimer_stop = false;
+
+static bool queue_push(struct autoptr *manager)
+{
+        size_t pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+
+        for (;;) {
+                struct cell *cell    = &queue[pos & queue_mask];
+                const size_t seq     = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+                const intptr_t delta = (intptr_t)seq - (intptr_t)pos;
+
+                if (delta == 0) {
+                        if (__atomic_compare_exchange_n(&enqueue_pos, &pos, pos + 1, true, __ATOMIC_RELAXED,
+                                                        __ATOMIC_RELAXED)) {
+                                cell->manager = manager;
+                                __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+                                return true;
+                        }
+                } else if (delta < 0) {
+                        return false; // Full
+                } else {
+                        pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+                }
+        }
+}
+
+static struct autoptr *queue_pop(void)
+{
+        size_t pos = __atomic_load_n(&dequeue_pos, __ATOMIC_RELAXED);
+
+        for (;;) {
+                struct cell *cell    = &queue[pos & queue_mask];
+                const size_t seq     = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+                const intptr_t delta = (intptr_t)seq - (intptr_t)(pos + 1);
+
+                if (delta == 0) {
+                        if (__atomic_compare_exchange_n(&dequeue_pos, &pos, pos + 1, true, __ATOMIC_RELAXED,
+                                                        __ATOMIC_RELAXED)) {
+                                struct autoptr *manager = cell->manager;
+                                __atomic_store_n(&cell->seq, pos + queue_mask + 1, __ATOMIC_RELEASE);
+                                return manager;
+                        }
+                } else if (delta < 0) {
+                        return NULL; // Empty
+                } else {
+                        pos = __atomic_load_n(&dequeue_pos, __ATOMIC_RELAXED);
+                }
+        }
+}
+
+bool __autoptr_reclaim_defer(struct autoptr *manager)
+{
+        if (!__atomic_load_n(&enabled, __ATOMIC_RELAXED))
+                return false;
+
+        // Announce the push so that autoptr_reclaim_stop() can wait for it before the final drain
+        __atomic_add_fetch(&in_flight, 1, __ATOMIC_SEQ_CST);
+
+        const bool deferred = __atomic_load_n(&enabled, __ATOMIC_SEQ_CST) && queue_push(manager);
+        if (deferred && __atomic_load_n(&background, __ATOMIC_RELAXED))
+                sem_post(&reclaimer_sem);
+
+        __atomic_sub_fetch(&in_flight, 1, __ATOMIC_RELEASE);
+
+        return deferred;
+}
+
+static void *reclaimer_main(void *arg)
+{
+        (void)arg;
+
+        for (;;) {
+                while (sem_wait(&reclaimer_sem) != 0 && errno == EINTR)
+                        ;
+
+                if (__atomic_load_n(&reclaimer_stop, __ATOMIC_ACQUIRE))
+                        break;
+
+                autoptr_reclaim_drain();
+        }
+        return NULL;
+}
+
+static void reclaim_atexit(void)
+{
+        autoptr_reclaim_stop();
+}
+
+int autoptr_reclaim_start(size_t depth, bool start_background)
+{
+        int ret = -1;
+
+        pthread_mutex_lock(&reclaim_mutex);
+
+        if (enabled)
+                goto finish;
+
+        size_t capacity = 2;
+        while (capacity < depth)
+                capacity <<= 1;
+
+        // The queue is reused by later starts of the same depth; it is empty while deferred reclaim is disabled
+        if (queue == NULL || capacity != queue_mask + 1) {
+                struct cell *cells = malloc(capacity * sizeof(*cells));
+                if (cells == NULL)
+                        goto finish;
+
+                for (size_t n = 0; n < capacity; ++n)
+                        cells[n].seq = n;
+
+                if (queue == NULL) {
+                        if (sem_init(&reclaimer_sem, 0, 0) != 0) {
+                                free(cells);
+                                goto finish;
+                        }
+
+                        // Flush-on-exit guarantee
+                        atexit(reclaim_atexit);
+                }
+
+                free(queue);
+                queue_mask = capacity - 1;
+                __atomic_store_n(&enqueue_pos, 0, __ATOMIC_RELAXED);
+                __atomic_store_n(&dequeue_pos, 0, __ATOMIC_RELAXED);
+                __atomic_store_n(&queue, cells, __ATOMIC_RELEASE);
+        }
+
+        if (start_background) {
+                __atomic_store_n(&reclaimer_stop, false, __ATOMIC_RELAXED);
+                if (pthread_create(&reclaimer, NULL, reclaimer_main, NULL) != 0)
+                        goto finish;
+        }
+
+        __atomic_store_n(&background, start_background, __ATOMIC_RELAXED);
+        __atomic_store_n(&enabled, true, __ATOMIC_SEQ_CST);
+        ret = 0;
+finish:
+        pthread_mutex_unlock(&reclaim_mutex);
+        return ret;
+}
+
+void autoptr_reclaim_stop(void)
+{
+        pthread_mutex_lock(&reclaim_mutex);
+
+        if (!enabled)
+                goto finish;
+
+        __atomic_store_n(&enabled, false, __ATOMIC_SEQ_CST);
+
+        // Unbinds that saw deferred reclaim enabled finish their push
+        while (__atomic_load_n(&in_flight, __ATOMIC_ACQUIRE) != 0)
+                sched_yield();
+
+        if (background) {
+                __atomic_store_n(&reclaimer_stop, true, __ATOMIC_RELEASE);
+                sem_post(&reclaimer_sem);
+                pthread_join(reclaimer, NULL);
+                __atomic_store_n(&background, false, __ATOMIC_RELAXED);
+        }
+
+        autoptr_reclaim_drain();
+finish:
+        pthread_mutex_unlock(&reclaim_mutex);
+}
+
+size_t autoptr_reclaim_drain(void)
+{
+        if (__atomic_load_n(&queue, __ATOMIC_ACQUIRE) == NULL)
+                return 0;
+
+        size_t num_destroyed = 0;
+        struct autoptr *manager;
+
+        while ((manager = queue_pop()) != NULL) {
+                __autoptr_destroy(manager);
+                ++num_destroyed;
+        }
+        return num_destroyed;
+}
+
+size_t autoptr_reclaim_pending(void)
+{
+        const size_t dequeued = __atomic_load_n(&dequeue_pos, __ATOMIC_RELAXED);
+        const size_t enqueued = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+
+        return enqueued > dequeued ? enqueued - dequeued : 0;
+}
@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2017-2019 Jason Graham <jgraham@compukix.net>
+ *
+ * This file is part of libautoptr.
+ *
+ * libautoptr is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libautoptr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libautoptr.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+/*
+ * Regions
+ *
+ * Every allocation is preceded by a prefix holding its region, which is how a destroyed managed set finds the
+ * region to account to. Allocations are bumped from a list of chunks of AUTOPTR_REGION_CHUNK_LEN bytes; a reset
+ * rewinds to the first chunk and keeps the others for reuse, so it does not depend on the number of allocations.
+ * Allocations larger than AUTOPTR_REGION_MAX_ALLOC_LEN get a chunk of their own, freed by the reset.
+ *
+ * The live count is the only state touched by other threads: it is incremented by autoptr_region_set_allocd and
+ * decremented, with release ordering, when the storage of a managed set is given back. A reset that reads it as
+ * zero (with acquire ordering) may reuse the storage.
+ */
+#include "autoptr_private.h"
+#include <libautoptr/autoptr_region.h>
+#include <stdint.h>
+#include <string.h>
+
+#define ALLOC_ALIGN 16
+#define PREFIX_LEN ALLOC_ALIGN // Holds the region of the allocation
+#define POISON 0xA5
+
+struct chunk {
+        struct chunk *next;
+        size_t len; // Length of the data in bytes
+        char data[] __attribute__((aligned(ALLOC_ALIGN)));
+};
+
+struct autoptr_region {
+        struct chunk *chunks;  ///< Bump chunks, in order of use
+        struct chunk *current; ///< Chunk allocations are bumped from
+        char *top;             ///< Next free byte of the current chunk
+        struct chunk *large;   ///< Chunks of oversized allocations
+        size_t live;           ///< Number of managed sets not yet destroyed (atomic)
+};
+
+static struct chunk *chunk_alloc(size_t len)
+{
+        struct chunk *chunk = malloc(sizeof(*chunk) + len);
+        if (chunk != NULL) {
+                chunk->next = NULL;
+                chunk->len  = len;
+        }
+        return chunk;
+}
+
+static inline struct autoptr_region **prefix(void *ptr)
+{
+        return (struct autoptr_region **)((char *)ptr - PREFIX_LEN);
+}
+
+struct autoptr_region *autoptr_region_create(void)
+{
+        struct autoptr_region *region = calloc(1, sizeof(*region));
+        if (region == NULL)
+                return NULL;
+
+        if ((region->chunks = chunk_alloc(AUTOPTR_REGION_CHUNK_LEN)) == NULL) {
+                free(region);
+                return NULL;
+        }
+        region->current = region->chunks;
+        region->top     = region->chunks->data;
+
+        return region;
+}
+
+/*
+ * Frees the chunks of oversized allocations
+ */
+static void free_large(struct autoptr_region *region)
+{
+        while (region->large != NULL) {
+                struct chunk *next = region->large->next;
+                free(region->large);
+                region->large = next;
+        }
+}
+
+void autoptr_region_destroy(struct autoptr_region *region)
+{
+        if (region == NULL)
+                return;
+
+        const size_t live = __atomic_load_n(&region->live, __ATOMIC_ACQUIRE);
+        if (live != 0) {
+#ifndef NDEBUG
+                fprintf(stderr, "autoptr_region_destroy: %zu managed sets outlive region %p\n", live,
+                        (void *)region);
+                abort();
+#endif
+                // Their destruction still accounts to the region, which is left to them
+                return;
+        }
+
+        free_large(region);
+        while (region->chunks != NULL) {
+                struct chunk *next = region->chunks->next;
+                free(region->chunks);
+                region->chunks = next;
+        }
+        free(region);
+}
+
+void *autoptr_region_alloc(struct autoptr_region *region, size_t len)
+{
+        const size_t alloc_len = PREFIX_LEN + (len + ALLOC_ALIGN - 1) / ALLOC_ALIGN * ALLOC_ALIGN;
+        char *alloc;
+
+        if (alloc_len < len)
+                return NULL;
+
+        if (alloc_len > AUTOPTR_REGION_MAX_ALLOC_LEN) {
+                struct chunk *chunk = chunk_alloc(alloc_len);
+                if (chunk == NULL)
+                        return NULL;
+
+                chunk->next   = region->large;
+                region->large = chunk;
+                alloc         = chunk->data;
+                goto finish;
+        }
+
+        if (region->top + alloc_len > region->current->data + region->current->len) {
+                // Move on to the next chunk, reused after a reset or new
+                if (region->current->next == NULL &&
+                    (region->current->next = chunk_alloc(AUTOPTR_REGION_CHUNK_LEN)) == NULL)
+                        return NULL;
+
+                region->current = region->current->next;
+                region->top     = region->current->data;
+        }
+        alloc = region->top;
+        region->top += alloc_len;
+finish:
+        *(struct autoptr_region **)alloc = region;
+        memset(alloc + PREFIX_LEN, 0, alloc_len - PREFIX_LEN);
+
+        return alloc + PREFIX_LEN;
+}
+
+void *autoptr_region_valloc(struct autoptr_region *region, size_t obj_len, size_t num_obj)
+{
+        if (num_obj != 0 && obj_len > SIZE_MAX / num_obj)
+                return NULL;
+
+        return autoptr_region_alloc(region, obj_len * num_obj);
+}
+
+void autoptr_region_set_allocd(void *ptr)
+{
+        __atomic_add_fetch(&(*prefix(AUTOPTR_M(ptr)))->live, 1, __ATOMIC_RELAXED);
+
+        AUTOPTR_M_LOCK(ptr);
+#if AUTOPTR_COMPACT
+        AUTOPTR_M(ptr)->flags |= AUTOPTR_F_REGION;
+#else
+        AUTOPTR_M(ptr)->regional = true;
+#endif
+        AUTOPTR_M_UNLOCK(ptr);
+}
+
+void __autoptr_region_release(struct autoptr *manager)
+{
+        // Release pairs with the acquire in autoptr_region_reset(), which may then reuse the storage
+        __atomic_sub_fetch(&(*prefix(manager))->live, 1, __ATOMIC_RELEASE);
+}
+
+size_t autoptr_region_live(struct autoptr_region *region)
+{
+        return __atomic_load_n(&region->live, __ATOMIC_ACQUIRE);
+}
+
+int autoptr_region_reset(struct autoptr_region *region)
+{
+        if (__atomic_load_n(&region->live, __ATOMIC_ACQUIRE) != 0)
+                return -1;
+
+#ifdef AUTOPTR_ASSERT
+        // Stale objects fail their magic number check
+        for (struct chunk *chunk = region->chunks; chunk != region->current->next; chunk = chunk->next)
+                memset(chunk->data, POISON, chunk == region->current ? (size_t)(region->top - chunk->data)
+                                                                     : chunk->len);
+#endif
+        free_large(region);
+        region->current = region->chunks;
+        region->top     = region->chunks->data;
+
+        return 0;
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2017-2019 Jason Graham <jgraham@compukix.net>
+ *
+ * This file is part of libautoptr.
+ *
+ * libautoptr is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libautoptr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libautoptr.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+/*
+ * Segmented vectors
+ *
+ * The vector holds the creator's ownership of each of its chunks; objects bound elsewhere hold references to the
+ * manager of their chunk only. Growing the directory copies the chunk addresses, never the objects.
+ */
+#include "autoptr_private.h"
+#include <libautoptr/autoptr_segvec.h>
+
+#define MIN_CHUNKS 8 // Initial capacity of the directory
+
+void autoptr_segvec_init(struct autoptr_segvec *v, size_t obj_len, size_t chunk_len,
+                         const struct autoptr_allocator *allocator, void (*obj_dtor)(void *))
+{
+        assert(obj_len >= sizeof(struct autoptr));
+
+        v->chunks      = NULL;
+        v->num_chunks  = 0;
+        v->max_chunks  = 0;
+        v->len         = 0;
+        v->obj_len     = obj_len;
+        v->chunk_shift = 0;
+        v->allocator   = allocator;
+        v->obj_dtor    = obj_dtor;
+
+        while (autoptr_segvec_chunk_len(v) < chunk_len)
+                ++v->chunk_shift;
+}
+
+void autoptr_segvec_destroy(struct autoptr_segvec *v)
+{
+        autoptr_segvec_truncate(v, 0);
+
+        free(v->chunks);
+        v->chunks     = NULL;
+        v->max_chunks = 0;
+}
+
+/*
+ * Appends a chunk to the directory; returns false if it could not be allocated
+ */
+static bool grow(struct autoptr_segvec *v)
+{
+        if (v->num_chunks == v->max_chunks) {
+                const size_t max_chunks = v->max_chunks ? 2 * v->max_chunks : MIN_CHUNKS;
+                void **chunks           = realloc(v->chunks, max_chunks * sizeof(*chunks));
+
+                if (chunks == NULL)
+                        return false;
+
+                v->chunks     = chunks;
+                v->max_chunks = max_chunks;
+        }
+
+        void *chunk = autoptr_valloc_with(v->allocator, v->obj_len, autoptr_segvec_chunk_len(v), v->obj_dtor);
+        if (chunk == NULL)
+                return false;
+
+        v->chunks[v->num_chunks++] = chunk;
+        return true;
+}
+
+void *autoptr_segvec_push(struct autoptr_segvec *v)
+{
+        if ((v->len >> v->chunk_shift) == v->num_chunks && !grow(v))
+                return NULL;
+
+        return autoptr_segvec_at(v, v->len++);
+}
+
+void autoptr_segvec_truncate(struct autoptr_segvec *v, size_t len)
+{
+        assert(len <= v->len && (len & (autoptr_segvec_chunk_len(v) - 1)) == 0);
+
+        const size_t num_chunks = len >> v->chunk_shift;
+
+        // The last chunks go first, as the objects of a set
+        while (v->num_chunks > num_chunks)
+                autoptr_vfree_obj(&v->chunks[--v->num_chunks], autoptr_segvec_chunk_len(v));
+
+        v->len = len;
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2017-2019 Jason Graham <jgraham@compukix.net>
+ *
+ * This file is part of libautoptr.
+ *
+ * libautoptr is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libautoptr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libautoptr.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+/*
+ * Sharded reference counts
+ *
+ * The number of references of a sharded set is the reference count of the manager, less AUTOPTR_SHARD_PIN, plus
+ * the deltas of the shards. The pin keeps the count away from zero, so releases through the shards or the count
+ * never find the last reference while the set is sharded.
+ *
+ * Draining is two-phase. Each shard is first closed with an atomic OR, which returns its final delta; retains and
+ * releases that find a shard closed redo the update on the count. The delta is then added to the count. Releases
+ * redirected to the count may run ahead of the delta of their shard, which the pin absorbs. Once every shard is
+ * drained the pin is released like AUTOPTR_SHARD_PIN references, which finds the last reference if every other
+ * one, the creator's included, is gone.
+ *
+ * The shards stay allocated (and closed) until the manager is destroyed since threads may still be about to use
+ * them.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "autoptr_private.h"
+
+#if AUTOPTR_SHARDED
+
+__thread unsigned int __autoptr_shard_self = 0;
+
+static unsigned int next_shard = 0;
+
+unsigned int __autoptr_shard_register(void)
+{
+        // Threads take the shards in turn
+        return __autoptr_shard_self = __atomic_fetch_add(&next_shard, 1, __ATOMIC_RELAXED) % AUTOPTR_NUM_SHARDS + 1;
+}
+
+int autoptr_set_sharded(void *ptr)
+{
+        struct autoptr *manager = AUTOPTR_M(ptr);
+        struct autoptr_shard *shards;
+        int rc = -1;
+
+        if (posix_memalign((void **)&shards, sizeof(*shards), AUTOPTR_NUM_SHARDS * sizeof(*shards)) != 0)
+                return -1;
+
+        for (size_t n = 0; n < AUTOPTR_NUM_SHARDS; ++n)
+                atomic_init(&shards[n].count, 0);
+
+        AUTOPTR_LOCK(manager);
+        if (atomic_load_explicit(&manager->shards, memory_order_relaxed) != NULL)
+                goto finish;
+
+        // The pin goes on the count before any release can go to the shards
+        atomic_fetch_add_explicit(&manager->r_count, AUTOPTR_SHARD_PIN, memory_order_relaxed);
+        atomic_store_explicit(&manager->shards, shards, memory_order_release);
+        shards = NULL;
+        rc     = 0;
+finish:
+        AUTOPTR_UNLOCK(manager);
+        free(shards);
+
+        return rc;
+}
+
+void __autoptr_shard_drain(struct autoptr *manager)
+{
+        if (!__autoptr_sharded(manager))
+                return;
+
+        struct autoptr_shard *shards = atomic_load_explicit(&manager->shards, memory_order_acquire);
+
+        // Serializes drains; the last shard closed is the first one, which tells that the set was drained
+        AUTOPTR_LOCK(manager);
+        if (!__autoptr_sharded(manager)) {
+                AUTOPTR_UNLOCK(manager);
+                return;
+        }
+
+        for (size_t n = AUTOPTR_NUM_SHARDS; n-- > 0;) {
+                // Acquire pairs with the releases through the shard
+                const long count =
+                    atomic_fetch_or_explicit(&shards[n].count, AUTOPTR_SHARD_CLOSED, memory_order_acq_rel);
+                if (count != 0)
+                        atomic_fetch_add_explicit(&manager->r_count, (int)(count / 2), memory_order_acq_rel);
+        }
+        AUTOPTR_UNLOCK(manager);
+
+        if (__autoptr_release_last(manager, AUTOPTR_SHARD_PIN))
+                __autoptr_reclaim(manager);
+}
+
+int __autoptr_shard_references(struct autoptr *manager)
+{
+        struct autoptr_shard *shards = atomic_load_explicit(&manager->shards, memory_order_acquire);
+        long references = atomic_load_explicit(&manager->r_count, memory_order_relaxed) - AUTOPTR_SHARD_PIN;
+
+        for (size_t n = 0; n < AUTOPTR_NUM_SHARDS; ++n)
+                references += atomic_load_explicit(&shards[n].count, memory_order_relaxed) / 2;
+
+        return (int)references;
+}
+
+void autoptr_unshard(void *ptr)
+{
+        __autoptr_shard_drain(AUTOPTR_M(ptr));
+}
+
+#endif // AUTOPTR_SHARDED
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2017-2019 Jason Graham <jgraham@compukix.net>
+ *
+ * This file is part of libautoptr.
+ *
+ * libautoptr is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libautoptr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libautoptr.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+/*
+ * Slices
+ *
+ * The reference of a slice is an ordinary bound reference to the manager of its set; the range only restricts
+ * which objects the holder uses. All objects of a set share the count of the manager, so one reference keeps any
+ * range of the set alive.
+ */
+#include "autoptr_private.h"
+#include <libautoptr/autoptr_slice.h>
+
+struct autoptr_slice autoptr_slice_bind(void *ptr, size_t offset, size_t len)
+{
+        autoptr_assert(ptr);
+
+        struct autoptr *manager = AUTOPTR_M(ptr);
+        assert(offset <= __autoptr_num_managed(manager) && len <= __autoptr_num_managed(manager) - offset);
+
+        return (struct autoptr_slice){
+            .base   = autoptr_bind(manager),
+            .offset = offset,
+            .len    = len,
+            .stride = __autoptr_obj_len(manager),
+        };
+}
+
+struct autoptr_slice autoptr_slice_dup(const struct autoptr_slice *slice)
+{
+        assert(slice->base != NULL);
+
+        struct autoptr_slice dup = *slice;
+        dup.base                 = autoptr_bind(slice->base);
+        return dup;
+}
+
+void autoptr_slice_unbind(struct autoptr_slice *slice)
+{
+        autoptr_unbind(&slice->base);
+        slice->offset = 0;
+        slice->len    = 0;
+}
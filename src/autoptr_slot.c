@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2017-2019 Jason Graham <jgraham@compukix.net>
+ *
+ * This file is part of libautoptr.
+ *
+ * libautoptr is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libautoptr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libautoptr.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+#include "autoptr_private.h"
+#include <libautoptr/autoptr_slot.h>
+#include <sched.h>
+
+/*
+ * A reader increments a reader counter before reading the pointer and decrements it once the object is bound. The
+ * counter increments, the pointer accesses and the counter checks of the writers are sequentially consistent, so a
+ * reader either is counted when the writer checks its counter or reads the pointer after it was replaced. The
+ * writer waits for each counter to drain in turn, flipping the epoch first so that new loads go to the other
+ * counter and the wait cannot be starved.
+ */
+static void synchronize(struct autoptr_slot *slot)
+{
+        for (int n = 0; n < 2; ++n) {
+                const unsigned int epoch = __atomic_fetch_add(&slot->epoch, 1, __ATOMIC_SEQ_CST) & 1;
+
+                while (__atomic_load_n(&slot->readers[epoch], __ATOMIC_SEQ_CST) != 0)
+                        sched_yield();
+        }
+}
+
+/*
+ * Publishes a new reference (writer mutex held) and returns the displaced one once no reader can still bind it
+ */
+static void *replace(struct autoptr_slot *slot, void *ptr)
+{
+        if (ptr != NULL)
+                ptr = autoptr_bind(ptr);
+
+        void *old = __atomic_exchange_n(&slot->ptr, ptr, __ATOMIC_SEQ_CST);
+        if (old != NULL)
+                synchronize(slot);
+
+        return old;
+}
+
+void autoptr_slot_init(struct autoptr_slot *slot, void *ptr)
+{
+        slot->ptr        = ptr != NULL ? autoptr_bind(ptr) : NULL;
+        slot->epoch      = 0;
+        slot->readers[0] = 0;
+        slot->readers[1] = 0;
+        pthread_mutex_init(&slot->mutex, NULL);
+}
+
+void autoptr_slot_destroy(struct autoptr_slot *slot)
+{
+        autoptr_unbind(&slot->ptr);
+        pthread_mutex_destroy(&slot->mutex);
+}
+
+void *autoptr_slot_load(struct autoptr_slot *slot)
+{
+        // The epoch only spreads readers over the counters; any value is safe
+        const unsigned int epoch = __atomic_load_n(&slot->epoch, __ATOMIC_RELAXED) & 1;
+
+        __atomic_add_fetch(&slot->readers[epoch], 1, __ATOMIC_SEQ_CST);
+
+        void *ptr = __atomic_load_n(&slot->ptr, __ATOMIC_SEQ_CST);
+        if (ptr != NULL)
+                ptr = autoptr_bind(ptr);
+
+        __atomic_sub_fetch(&slot->readers[epoch], 1, __ATOMIC_RELEASE);
+
+        return ptr;
+}
+
+void autoptr_slot_store(struct autoptr_slot *slot, void *ptr)
+{
+        pthread_mutex_lock(&slot->mutex);
+        void *old = replace(slot, ptr);
+        pthread_mutex_unlock(&slot->mutex);
+
+        autoptr_unbind(&old);
+}
+
+void *autoptr_slot_exchange(struct autoptr_slot *slot, void *ptr)
+{
+        pthread_mutex_lock(&slot->mutex);
+        void *old = replace(slot, ptr);
+        pthread_mutex_unlock(&slot->mutex);
+
+        return old;
+}
+
+bool autoptr_slot_compare_exchange(struct autoptr_slot *slot, void *expected, void *desired)
+{
+        void *old = NULL;
+
+        pthread_mutex_lock(&slot->mutex);
+
+        // Only writers change the pointer, and they hold the mutex
+        const bool equal = (slot->ptr == expected);
+        if (equal)
+                old = replace(slot, desired);
+
+        pthread_mutex_unlock(&slot->mutex);
+
+        autoptr_unbind(&old);
+        return equal;
+}
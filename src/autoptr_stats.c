@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) 2017-2019 Jason Graham <jgraham@compukix.net>
+ *
+ * This file is part of libautoptr.
+ *
+ * libautoptr is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libautoptr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libautoptr.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+/*
+ * Per-type statistics
+ *
+ * Every thread counts in its own open-addressed table keyed by the object destructor and length. A thread is the
+ * only writer of its table, so the counters are updated with relaxed loads and stores rather than atomic
+ * read-modify-write operations; snapshots read them with relaxed loads. A slot is claimed by storing its key, the
+ * length last with release ordering, and is never reused. Types that do not fit the table are counted in an
+ * overflow slot with a NULL destructor and zero length.
+ *
+ * The tables are linked in a registry. When a thread exits its counters are added to the table of retired threads
+ * and its table is freed.
+ */
+#include "autoptr_private.h"
+#include <libautoptr/autoptr_stats.h>
+#include <stdint.h>
+#include <string.h>
+
+#if AUTOPTR_STATS
+
+#define TABLE_SIZE 256 // Power of two
+#define OVERFLOW TABLE_SIZE
+
+struct counters {
+        void (*obj_dtor)(void *);
+        size_t obj_len; // Zero in an unclaimed slot
+        long live;
+        long peak;
+        unsigned long binds;
+        unsigned long unbinds;
+};
+
+struct table {
+        struct counters slot[TABLE_SIZE + 1];
+        struct table *next;
+        struct table **prev;
+};
+
+static __thread struct table *self __attribute__((tls_model("initial-exec"))) = NULL;
+
+static pthread_mutex_t registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct table *registry         = NULL;
+static struct table retired; // Counters of exited threads (registry mutex held)
+
+static pthread_key_t table_key;
+static pthread_once_t table_key_once = PTHREAD_ONCE_INIT;
+
+static inline size_t hash(size_t obj_len, void (*obj_dtor)(void *))
+{
+        const uint64_t h = ((uint64_t)(uintptr_t)obj_dtor ^ (obj_len << 32 | obj_len)) * 0x9E3779B97F4A7C15ULL;
+        return (size_t)(h >> 56) & (TABLE_SIZE - 1);
+}
+
+/*
+ * Finds or claims the slot of a type. Only the owner of the table (or the holder of the registry mutex for the
+ * retired table) may call this.
+ */
+static struct counters *lookup(struct table *table, size_t obj_len, void (*obj_dtor)(void *))
+{
+        size_t index = hash(obj_len, obj_dtor);
+
+        for (size_t probe = 0; probe < TABLE_SIZE; ++probe) {
+                struct counters *c = &table->slot[index];
+
+                if (c->obj_len == obj_len && c->obj_dtor == obj_dtor)
+                        return c;
+                if (c->obj_len == 0) {
+                        c->obj_dtor = obj_dtor;
+                        __atomic_store_n(&c->obj_len, obj_len, __ATOMIC_RELEASE);
+                        return c;
+                }
+                index = (index + 1) & (TABLE_SIZE - 1);
+        }
+        return &table->slot[OVERFLOW];
+}
+
+// Single-writer counter updates
+#define COUNTER_ADD(c, n) __atomic_store_n(&(c), __atomic_load_n(&(c), __ATOMIC_RELAXED) + (n), __ATOMIC_RELAXED)
+
+/*
+ * Adds the counters of one slot to another (registry mutex held)
+ */
+static void add_counters(struct counters *sum, const struct counters *c)
+{
+        sum->live += __atomic_load_n(&c->live, __ATOMIC_RELAXED);
+        sum->peak += __atomic_load_n(&c->peak, __ATOMIC_RELAXED);
+        sum->binds += __atomic_load_n(&c->binds, __ATOMIC_RELAXED);
+        sum->unbinds += __atomic_load_n(&c->unbinds, __ATOMIC_RELAXED);
+}
+
+/*
+ * Adds the counters of a table to the slots of the same types in another (registry mutex held)
+ */
+static void add_table(struct table *sum, const struct table *table)
+{
+        for (size_t n = 0; n < TABLE_SIZE; ++n) {
+                const struct counters *c = &table->slot[n];
+
+                const size_t obj_len = __atomic_load_n(&c->obj_len, __ATOMIC_ACQUIRE);
+                if (obj_len != 0)
+                        add_counters(lookup(sum, obj_len, c->obj_dtor), c);
+        }
+        add_counters(&sum->slot[OVERFLOW], &table->slot[OVERFLOW]);
+}
+
+static void table_exit(void *arg)
+{
+        struct table *table = arg;
+
+        pthread_mutex_lock(&registry_mutex);
+        add_table(&retired, table);
+        *table->prev = table->next;
+        if (table->next != NULL)
+                table->next->prev = table->prev;
+        pthread_mutex_unlock(&registry_mutex);
+
+        // Destructors of other keys may still count; they register a new table
+        self = NULL;
+        free(table);
+}
+
+static void table_key_create(void)
+{
+        pthread_key_create(&table_key, table_exit);
+}
+
+static struct table *table_register(void)
+{
+        struct table *table = calloc(1, sizeof(*table));
+        if (table == NULL)
+                return NULL;
+
+        pthread_once(&table_key_once, table_key_create);
+        pthread_setspecific(table_key, table);
+
+        pthread_mutex_lock(&registry_mutex);
+        table->next = registry;
+        table->prev = &registry;
+        if (registry != NULL)
+                registry->prev = &table->next;
+        registry = table;
+        pthread_mutex_unlock(&registry_mutex);
+
+        return self = table;
+}
+
+void __autoptr_stats_count(const struct autoptr *manager, int event, long n)
+{
+        struct table *table = self;
+        if (table == NULL && (table = table_register()) == NULL)
+                return;
+
+        struct counters *c = lookup(table, __autoptr_obj_len(manager), __autoptr_obj_dtor(manager));
+        long live;
+
+        switch (event) {
+        case AUTOPTR_STATS_CTOR:
+                live = __atomic_load_n(&c->live, __ATOMIC_RELAXED) + n;
+                __atomic_store_n(&c->live, live, __ATOMIC_RELAXED);
+                if (live > __atomic_load_n(&c->peak, __ATOMIC_RELAXED))
+                        __atomic_store_n(&c->peak, live, __ATOMIC_RELAXED);
+                break;
+        case AUTOPTR_STATS_DTOR:
+                COUNTER_ADD(c->live, -n);
+                break;
+        case AUTOPTR_STATS_BIND:
+                COUNTER_ADD(c->binds, (unsigned long)n);
+                break;
+        case AUTOPTR_STATS_UNBIND:
+                COUNTER_ADD(c->unbinds, (unsigned long)n);
+                break;
+        }
+}
+
+static int compare_bytes(const void *a, const void *b)
+{
+        const struct autoptr_stats *sa = a;
+        const struct autoptr_stats *sb = b;
+
+        return (sa->bytes < sb->bytes) - (sa->bytes > sb->bytes);
+}
+
+size_t autoptr_stats_snapshot(struct autoptr_stats *stats, size_t size)
+{
+        struct table *sum = calloc(1, sizeof(*sum));
+        if (sum == NULL)
+                return 0;
+
+        pthread_mutex_lock(&registry_mutex);
+        add_table(sum, &retired);
+        for (struct table *table = registry; table != NULL; table = table->next)
+                add_table(sum, table);
+        pthread_mutex_unlock(&registry_mutex);
+
+        // Collect every type, then keep the largest ones
+        struct autoptr_stats *all = malloc((TABLE_SIZE + 1) * sizeof(*all));
+        size_t num_types          = 0;
+
+        if (all == NULL)
+                goto finish;
+
+        for (size_t n = 0; n <= TABLE_SIZE; ++n) {
+                const struct counters *c = &sum->slot[n];
+                if (n < OVERFLOW ? c->obj_len == 0 : c->peak == 0 && c->binds == 0 && c->unbinds == 0)
+                        continue;
+
+                all[num_types++] = (struct autoptr_stats){
+                    .obj_dtor = c->obj_dtor,
+                    .obj_len  = c->obj_len,
+                    .live     = c->live,
+                    .peak     = c->peak,
+                    .bytes    = c->live > 0 ? (size_t)c->live * c->obj_len : 0,
+                    .binds    = c->binds,
+                    .unbinds  = c->unbinds,
+                };
+        }
+
+        qsort(all, num_types, sizeof(all[0]), compare_bytes);
+        memcpy(stats, all, (num_types < size ? num_types : size) * sizeof(all[0]));
+        free(all);
+finish:
+        free(sum);
+        return num_types;
+}
+
+void autoptr_stats_dump(FILE *stream)
+{
+        static struct autoptr_stats stats[TABLE_SIZE + 1];
+        static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+        pthread_mutex_lock(&stats_mutex);
+        const size_t num_types = autoptr_stats_snapshot(stats, TABLE_SIZE + 1);
+
+        fprintf(stream, "obj_dtor,obj_len,live,peak,bytes,binds,unbinds\n");
+        for (size_t n = 0; n < num_types; ++n)
+                fprintf(stream, "%p,%zu,%ld,%ld,%zu,%lu,%lu\n", *(void **)&stats[n].obj_dtor, stats[n].obj_len,
+                        stats[n].live, stats[n].peak, stats[n].bytes, stats[n].binds, stats[n].unbinds);
+        fflush(stream);
+        pthread_mutex_unlock(&stats_mutex);
+}
+
+#endif // AUTOPTR_STATS
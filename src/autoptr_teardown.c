@@ -0,0 +1,235 @@
+/*
+ * Copyright (c) 2017-2019 Jason Graham <jgraham@compukix.net>
+ *
+ * This file is part of libautoptr.
+ *
+ * libautoptr is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libautoptr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libautoptr.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+/*
+ * Parallel teardown
+ *
+ * The destroying thread describes the set in a job on its stack and publishes it under the pool mutex. Workers
+ * join the job under the mutex while it is published and the destroying thread joins it too; all of them take
+ * blocks with an atomic counter, the blocks going from the end of the set towards the manager. The destroying
+ * thread withdraws the job once it runs out of blocks and waits until the blocks are done and no worker is left
+ * in the job, after which the job may go out of scope.
+ *
+ * The job slot is taken with a trylock, so a set that becomes due while another one is torn down is destroyed
+ * serially rather than waiting for the workers.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "autoptr_private.h"
+#include <libautoptr/autoptr_teardown.h>
+#include <unistd.h>
+
+struct job {
+        char *base;
+        size_t obj_len;
+        void (*obj_dtor)(void *);
+        size_t num_obj;     ///< Number of objects after the manager
+        size_t num_blocks;
+        size_t next_block;  ///< Next block to take (atomic)
+        size_t done_blocks; ///< Number of blocks destroyed (pool mutex held)
+        size_t active;      ///< Number of workers in the job (pool mutex held)
+};
+
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_cond   = PTHREAD_COND_INITIALIZER; ///< Signalled when a job is published
+static pthread_cond_t done_cond   = PTHREAD_COND_INITIALIZER; ///< Signalled when a worker leaves the job
+static struct job *current        = NULL;
+static unsigned long generation   = 0; ///< Number of jobs published, so that a worker joins each at most once
+static bool stopping              = false;
+
+static pthread_mutex_t job_mutex   = PTHREAD_MUTEX_INITIALIZER; ///< Held by the thread tearing down a set
+static pthread_mutex_t start_mutex = PTHREAD_MUTEX_INITIALIZER; ///< Serializes start and stop
+static pthread_t workers[AUTOPTR_TEARDOWN_MAX_WORKERS];
+static size_t num_workers = 0;
+static size_t threshold   = 0;
+static bool started       = false;
+
+/*
+ * Destroys blocks of a job until none is left; returns the number destroyed
+ */
+static size_t run_blocks(struct job *job)
+{
+        struct autoptr *const outer = __autoptr_destroying;
+        size_t num_done             = 0;
+        size_t block;
+
+        __autoptr_destroying = AUTOPTR(job->base);
+        while ((block = __atomic_fetch_add(&job->next_block, 1, __ATOMIC_RELAXED)) < job->num_blocks) {
+                // Objects 1 to num_obj; block 0 ends the set
+                const size_t end   = job->num_obj - block * AUTOPTR_TEARDOWN_BLOCK_LEN;
+                const size_t begin = end > AUTOPTR_TEARDOWN_BLOCK_LEN ? end - AUTOPTR_TEARDOWN_BLOCK_LEN : 0;
+
+                for (size_t i = end; i > begin; --i) {
+                        void *obj = job->base + job->obj_len * i;
+
+                        assert(AUTOPTR(obj)->manager == AUTOPTR(job->base));
+                        job->obj_dtor(obj);
+                }
+                ++num_done;
+        }
+        __autoptr_destroying = outer;
+        return num_done;
+}
+
+static void *worker_main(void *arg)
+{
+        unsigned long seen = 0;
+        (void)arg;
+
+        pthread_mutex_lock(&pool_mutex);
+        for (;;) {
+                while (!stopping && (current == NULL || generation == seen))
+                        pthread_cond_wait(&work_cond, &pool_mutex);
+                if (stopping)
+                        break;
+
+                struct job *job = current;
+                seen            = generation;
+                ++job->active;
+                pthread_mutex_unlock(&pool_mutex);
+
+                const size_t num_done = run_blocks(job);
+
+                pthread_mutex_lock(&pool_mutex);
+                job->done_blocks += num_done;
+                --job->active;
+                pthread_cond_signal(&done_cond);
+        }
+        pthread_mutex_unlock(&pool_mutex);
+
+        return NULL;
+}
+
+bool __autoptr_teardown(struct autoptr *manager)
+{
+        const size_t num_managed = __autoptr_num_managed(manager);
+
+        if (!__atomic_load_n(&started, __ATOMIC_ACQUIRE) ||
+            num_managed <= __atomic_load_n(&threshold, __ATOMIC_RELAXED))
+                return false;
+        if (pthread_mutex_trylock(&job_mutex) != 0)
+                return false;
+
+        struct job job = {
+            .base        = (char *)manager,
+            .obj_len     = __autoptr_obj_len(manager),
+            .obj_dtor    = __autoptr_obj_dtor(manager),
+            .num_obj     = num_managed - 1,
+            .num_blocks  = (num_managed - 1 + AUTOPTR_TEARDOWN_BLOCK_LEN - 1) / AUTOPTR_TEARDOWN_BLOCK_LEN,
+            .next_block  = 0,
+            .done_blocks = 0,
+            .active      = 0,
+        };
+
+        pthread_mutex_lock(&pool_mutex);
+        current = &job;
+        ++generation;
+        pthread_cond_broadcast(&work_cond);
+        pthread_mutex_unlock(&pool_mutex);
+
+        const size_t num_done = run_blocks(&job);
+
+        // Acquire the writes of the workers to the objects with the mutex
+        pthread_mutex_lock(&pool_mutex);
+        current = NULL;
+        job.done_blocks += num_done;
+        while (job.active != 0)
+                pthread_cond_wait(&done_cond, &pool_mutex);
+        assert(job.done_blocks == job.num_blocks);
+        pthread_mutex_unlock(&pool_mutex);
+
+        pthread_mutex_unlock(&job_mutex);
+
+        return true;
+}
+
+/*
+ * Stops and joins the workers; the start mutex is held
+ */
+static void stop_workers(void)
+{
+        pthread_mutex_lock(&pool_mutex);
+        stopping = true;
+        pthread_cond_broadcast(&work_cond);
+        pthread_mutex_unlock(&pool_mutex);
+
+        for (size_t n = 0; n < num_workers; ++n)
+                pthread_join(workers[n], NULL);
+        num_workers = 0;
+}
+
+int autoptr_teardown_start(size_t workers_len, size_t set_threshold)
+{
+        int ret = -1;
+
+        pthread_mutex_lock(&start_mutex);
+        if (started)
+                goto finish;
+
+        if (workers_len == 0) {
+                const long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+                workers_len         = num_cpus > 1 ? (size_t)num_cpus - 1 : 0;
+        }
+        if (workers_len > AUTOPTR_TEARDOWN_MAX_WORKERS)
+                workers_len = AUTOPTR_TEARDOWN_MAX_WORKERS;
+
+        stopping = false;
+        for (num_workers = 0; num_workers < workers_len; ++num_workers) {
+                if (pthread_create(&workers[num_workers], NULL, worker_main, NULL) != 0) {
+                        stop_workers();
+                        goto finish;
+                }
+        }
+
+        __atomic_store_n(&threshold, set_threshold, __ATOMIC_RELAXED);
+        __atomic_store_n(&started, true, __ATOMIC_RELEASE);
+        ret = 0;
+finish:
+        pthread_mutex_unlock(&start_mutex);
+        return ret;
+}
+
+void autoptr_teardown_stop(void)
+{
+        pthread_mutex_lock(&start_mutex);
+        if (!started)
+                goto finish;
+
+        // Sets due from now on are destroyed serially; wait for the one in progress
+        __atomic_store_n(&started, false, __ATOMIC_RELAXED);
+        pthread_mutex_lock(&job_mutex);
+        pthread_mutex_unlock(&job_mutex);
+
+        stop_workers();
+finish:
+        pthread_mutex_unlock(&start_mutex);
+}
+
+void autoptr_set_independent(void *ptr)
+{
+        autoptr_assert(ptr);
+
+        AUTOPTR_M_LOCK(ptr);
+#if AUTOPTR_COMPACT
+        AUTOPTR_M(ptr)->flags |= AUTOPTR_F_INDEPENDENT;
+#else
+        AUTOPTR_M(ptr)->independent = true;
+#endif
+        AUTOPTR_M_UNLOCK(ptr);
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2017-2019 Jason Graham <jgraham@compukix.net>
+ *
+ * This file is part of libautoptr.
+ *
+ * libautoptr is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libautoptr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libautoptr.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+#include "autoptr_private.h"
+#include <libautoptr/autoptr_tl.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * The buffer is an open-addressed table of managers with their number of pending releases. Entries are only
+ * removed by a flush, which empties the whole table; an entry whose releases were cancelled stays with a zero
+ * count until then.
+ */
+struct pending {
+        struct autoptr *manager;
+        int releases;
+};
+
+struct buffer {
+        struct pending entry[AUTOPTR_TL_SIZE];
+        size_t num_entries;
+};
+
+static __thread struct buffer buffer;
+static __thread bool buffer_registered = false;
+
+static pthread_key_t buffer_key;
+static pthread_once_t buffer_key_once = PTHREAD_ONCE_INIT;
+
+static void buffer_exit(void *arg)
+{
+        (void)arg;
+
+        // Destructors run by the flush may buffer again and register anew
+        buffer_registered = false;
+        autoptr_tl_flush();
+}
+
+static void buffer_key_create(void)
+{
+        pthread_key_create(&buffer_key, buffer_exit);
+}
+
+/*
+ * Flushes the buffer when the thread exits
+ */
+static void buffer_register(void)
+{
+        pthread_once(&buffer_key_once, buffer_key_create);
+        pthread_setspecific(buffer_key, &buffer);
+        buffer_registered = true;
+}
+
+static inline size_t hash(const struct autoptr *manager)
+{
+        return (size_t)(((uintptr_t)manager >> 4) * 0x9E3779B97F4A7C15ULL >> 32) & (AUTOPTR_TL_SIZE - 1);
+}
+
+/*
+ * Finds the entry of a manager; if it has none, returns the free entry to take or NULL if the buffer is full
+ */
+static struct pending *lookup(const struct autoptr *manager)
+{
+        size_t index = hash(manager);
+
+        for (size_t probe = 0; probe < AUTOPTR_TL_SIZE; ++probe) {
+                struct pending *p = &buffer.entry[index];
+
+                if (p->manager == manager || p->manager == NULL)
+                        return p;
+                index = (index + 1) & (AUTOPTR_TL_SIZE - 1);
+        }
+        return NULL;
+}
+
+void *autoptr_tl_bind(void *ptr)
+{
+        struct pending *p = lookup(AUTOPTR_M(ptr));
+
+        if (p != NULL && p->manager != NULL && p->releases > 0) {
+                AUTOPTR_STATS_COUNT(AUTOPTR_M(ptr), AUTOPTR_STATS_BIND, 1);
+                AUTOPTR_TRACE_EVENT(AUTOPTR_TRACE_BIND, ptr, AUTOPTR_M(ptr), 1, __builtin_return_address(0));
+                --p->releases;
+                return ptr;
+        }
+
+        return autoptr_bind(ptr);
+}
+
+void autoptr_tl_unbind(void **ptr)
+{
+        if (*ptr == NULL || AUTOPTR_M(*ptr) == NULL)
+                goto finish;
+
+        struct autoptr *manager = AUTOPTR_M(*ptr);
+        struct pending *p       = lookup(manager);
+
+        if (p == NULL) {
+                autoptr_tl_flush();
+                p = lookup(manager);
+        }
+        if (p->manager == NULL) {
+                if (!buffer_registered)
+                        buffer_register();
+                p->manager = manager;
+                ++buffer.num_entries;
+        }
+
+        AUTOPTR_STATS_COUNT(manager, AUTOPTR_STATS_UNBIND, 1);
+        AUTOPTR_TRACE_EVENT(AUTOPTR_TRACE_UNBIND, *ptr, manager, 1, __builtin_return_address(0));
+        ++p->releases;
+finish:
+        *ptr = NULL;
+}
+
+void autoptr_tl_flush(void)
+{
+        if (buffer.num_entries == 0)
+                return;
+
+        // Destructors may unbind through the buffer, so it is emptied before any release is applied
+        struct pending entry[AUTOPTR_TL_SIZE];
+        memcpy(entry, buffer.entry, sizeof(entry));
+        memset(buffer.entry, 0, sizeof(buffer.entry));
+        buffer.num_entries = 0;
+
+        // The releases were traced as unbinds when they were recorded
+        for (size_t n = 0; n < AUTOPTR_TL_SIZE; ++n) {
+                if (entry[n].manager == NULL || entry[n].releases == 0)
+                        continue;
+
+                if (__autoptr_release_last(entry[n].manager, entry[n].releases))
+                        __autoptr_reclaim(entry[n].manager);
+        }
+}
@@ -0,0 +1,295 @@
+/*
+ * Copyright (c) 2017-2019 Jason Graham <jgraham@compukix.net>
+ *
+ * This file is part of libautoptr.
+ *
+ * libautoptr is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libautoptr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libautoptr.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+/*
+ * Event trace
+ *
+ * Every thread records into its own ring; it is the only writer, so an event is written with relaxed stores and
+ * no read-modify-write operation. The writer announces an event by advancing begin before writing it and
+ * publishes it by advancing head after, like the two sequence counts of a seqlock: a dump copies the ring up to
+ * head, then rereads begin and drops the copied events that the writer may have overwritten meanwhile.
+ *
+ * The rings are linked in a registry and never freed. When a thread exits its ring is put on a free list and is
+ * taken over, with the events it holds, by the next thread that records.
+ */
+#define _GNU_SOURCE
+
+#include "autoptr_private.h"
+#include <dlfcn.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#if AUTOPTR_TRACE
+
+#define RING_MASK (AUTOPTR_TRACE_RING_LEN - 1)
+
+struct ring {
+        struct autoptr_trace_event event[AUTOPTR_TRACE_RING_LEN];
+        uint64_t begin;         ///< Number of events started by the writer
+        uint64_t head;          ///< Number of events written
+        uint32_t thread;        ///< Ring number
+        struct ring *next;      ///< Next ring of the registry
+        struct ring *next_free; ///< Next ring of the free list
+};
+
+static __thread struct ring *self __attribute__((tls_model("initial-exec"))) = NULL;
+
+static pthread_mutex_t registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct ring *registry          = NULL;
+static struct ring *free_rings        = NULL; // Rings of exited threads (registry mutex held)
+static uint32_t num_rings             = 0;
+
+static pthread_key_t ring_key;
+static pthread_once_t ring_key_once = PTHREAD_ONCE_INIT;
+
+static void ring_exit(void *arg)
+{
+        struct ring *ring = arg;
+
+        pthread_mutex_lock(&registry_mutex);
+        ring->next_free = free_rings;
+        free_rings      = ring;
+        pthread_mutex_unlock(&registry_mutex);
+
+        // Destructors of other keys may still record; they take a ring again
+        self = NULL;
+}
+
+static void ring_key_create(void)
+{
+        pthread_key_create(&ring_key, ring_exit);
+}
+
+static struct ring *ring_register(void)
+{
+        struct ring *ring;
+
+        pthread_once(&ring_key_once, ring_key_create);
+
+        pthread_mutex_lock(&registry_mutex);
+        if ((ring = free_rings) != NULL) {
+                free_rings = ring->next_free;
+        } else if ((ring = calloc(1, sizeof(*ring))) != NULL) {
+                ring->thread = ++num_rings;
+                ring->next   = registry;
+                registry     = ring;
+        }
+        pthread_mutex_unlock(&registry_mutex);
+
+        if (ring != NULL)
+                pthread_setspecific(ring_key, ring);
+        return self = ring;
+}
+
+/*
+ * Number of ownerships (bound references plus the creator) of a managed set; -1 while its count is sharded
+ */
+static int ownerships(struct autoptr *manager)
+{
+#if AUTOPTR_BIASED
+        return __autoptr_brc_ownerships(manager, __ATOMIC_RELAXED);
+#elif AUTOPTR_ATOMIC
+#if AUTOPTR_SHARDED
+        if (__autoptr_sharded(manager))
+                return -1;
+#endif
+        return atomic_load_explicit(&manager->r_count, memory_order_relaxed) + 1;
+#else
+        AUTOPTR_LOCK(manager);
+        const int r_count = manager->r_count;
+        AUTOPTR_UNLOCK(manager);
+        return r_count + 1;
+#endif
+}
+
+#define STORE(field, value) __atomic_store_n(&(field), value, __ATOMIC_RELAXED)
+#define LOAD(field) __atomic_load_n(&(field), __ATOMIC_RELAXED)
+
+__attribute__((noinline)) void __autoptr_trace(int event, const void *ptr, struct autoptr *manager, int n,
+                                               const void *caller)
+{
+        if (caller == NULL)
+                caller = __builtin_return_address(0);
+
+        struct ring *ring = self;
+        if (ring == NULL && (ring = ring_register()) == NULL)
+                return;
+
+        int count = 0;
+        if (event != AUTOPTR_TRACE_DESTROY && (count = ownerships(manager)) >= 0)
+                count += (event == AUTOPTR_TRACE_BIND ? n : -n);
+
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        const uint64_t index = LOAD(ring->head);
+        STORE(ring->begin, index + 1);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+
+        struct autoptr_trace_event *e = &ring->event[index & RING_MASK];
+        STORE(e->time_ns, (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec);
+        STORE(e->ptr, (uint64_t)(uintptr_t)ptr);
+        STORE(e->manager, (uint64_t)(uintptr_t)manager);
+        STORE(e->caller, (uint64_t)(uintptr_t)caller);
+        STORE(e->count, count);
+        STORE(e->n, n);
+        STORE(e->thread, ring->thread);
+        STORE(e->event, (uint32_t)event);
+
+        __atomic_store_n(&ring->head, index + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Copies the events of a ring that were not overwritten while copying; returns their number (registry mutex
+ * held)
+ */
+static size_t copy_ring(struct ring *ring, struct autoptr_trace_event *events, uint64_t *num_lost)
+{
+        const uint64_t head  = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        const uint64_t first = head > AUTOPTR_TRACE_RING_LEN ? head - AUTOPTR_TRACE_RING_LEN : 0;
+
+        for (uint64_t index = first; index < head; ++index) {
+                const struct autoptr_trace_event *e = &ring->event[index & RING_MASK];
+                struct autoptr_trace_event *copy    = &events[index - first];
+
+                copy->time_ns = LOAD(e->time_ns);
+                copy->ptr     = LOAD(e->ptr);
+                copy->manager = LOAD(e->manager);
+                copy->caller  = LOAD(e->caller);
+                copy->count   = LOAD(e->count);
+                copy->n       = LOAD(e->n);
+                copy->thread  = LOAD(e->thread);
+                copy->event   = LOAD(e->event);
+        }
+
+        // Events from begin - AUTOPTR_TRACE_RING_LEN on were not yet overwritten when copied
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        const uint64_t begin = __atomic_load_n(&ring->begin, __ATOMIC_RELAXED);
+        uint64_t valid       = begin > AUTOPTR_TRACE_RING_LEN ? begin - AUTOPTR_TRACE_RING_LEN : 0;
+        if (valid < first)
+                valid = first;
+        if (valid > head)
+                valid = head;
+
+        memmove(events, events + (valid - first), (head - valid) * sizeof(*events));
+        *num_lost += valid;
+        return head - valid;
+}
+
+static int compare_time(const void *a, const void *b)
+{
+        const struct autoptr_trace_event *ea = a;
+        const struct autoptr_trace_event *eb = b;
+
+        if (ea->time_ns != eb->time_ns)
+                return (ea->time_ns > eb->time_ns) - (ea->time_ns < eb->time_ns);
+        return (ea->thread > eb->thread) - (ea->thread < eb->thread);
+}
+
+static int compare_caller(const void *a, const void *b)
+{
+        const uint64_t ca = *(const uint64_t *)a;
+        const uint64_t cb = *(const uint64_t *)b;
+
+        return (ca > cb) - (ca < cb);
+}
+
+/*
+ * Writes the caller records of the distinct callers of the events
+ */
+static int write_callers(FILE *stream, const uint64_t *callers, size_t num_callers)
+{
+        for (size_t n = 0; n < num_callers; ++n) {
+                struct autoptr_trace_caller record = {.caller = callers[n], .offset = callers[n]};
+                const char *module                 = "";
+                const char *symbol                 = "";
+                Dl_info info;
+
+                if (dladdr((void *)(uintptr_t)callers[n], &info) != 0) {
+                        if (info.dli_fname != NULL) {
+                                module        = info.dli_fname;
+                                record.offset = callers[n] - (uint64_t)(uintptr_t)info.dli_fbase;
+                        }
+                        if (info.dli_sname != NULL)
+                                symbol = info.dli_sname;
+                }
+                record.module_len = (uint32_t)strlen(module);
+                record.symbol_len = (uint32_t)strlen(symbol);
+
+                if (fwrite(&record, sizeof(record), 1, stream) != 1 ||
+                    fwrite(module, 1, record.module_len, stream) != record.module_len ||
+                    fwrite(symbol, 1, record.symbol_len, stream) != record.symbol_len)
+                        return -1;
+        }
+        return 0;
+}
+
+int autoptr_trace_dump(FILE *stream)
+{
+        struct autoptr_trace_event *events = NULL;
+        uint64_t *callers                  = NULL;
+        int ret                            = -1;
+
+        struct autoptr_trace_header header = {
+            .version   = AUTOPTR_TRACE_VERSION,
+            .event_len = sizeof(struct autoptr_trace_event),
+        };
+        memcpy(header.magic, AUTOPTR_TRACE_MAGIC, sizeof(header.magic));
+
+        // Rings registered later are not dumped
+        pthread_mutex_lock(&registry_mutex);
+        events = malloc(((size_t)num_rings + 1) * AUTOPTR_TRACE_RING_LEN * sizeof(*events));
+        if (events != NULL) {
+                for (struct ring *ring = registry; ring != NULL; ring = ring->next)
+                        header.num_events += copy_ring(ring, events + header.num_events, &header.num_lost);
+        }
+        pthread_mutex_unlock(&registry_mutex);
+
+        if (events == NULL)
+                goto finish;
+
+        qsort(events, header.num_events, sizeof(*events), compare_time);
+
+        // Distinct callers
+        callers = malloc((header.num_events + 1) * sizeof(*callers));
+        if (callers == NULL)
+                goto finish;
+
+        for (size_t n = 0; n < header.num_events; ++n)
+                callers[n] = events[n].caller;
+        qsort(callers, header.num_events, sizeof(*callers), compare_caller);
+        for (size_t n = 0; n < header.num_events; ++n) {
+                if (header.num_callers == 0 || callers[header.num_callers - 1] != callers[n])
+                        callers[header.num_callers++] = callers[n];
+        }
+
+        if (fwrite(&header, sizeof(header), 1, stream) != 1 ||
+            fwrite(events, sizeof(*events), header.num_events, stream) != header.num_events ||
+            write_callers(stream, callers, header.num_callers) != 0 || fflush(stream) != 0)
+                goto finish;
+
+        ret = 0;
+finish:
+        free(callers);
+        free(events);
+        return ret;
+}
+
+#endif // AUTOPTR_TRACE
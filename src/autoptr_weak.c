@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2017-2019 Jason Graham <jgraham@compukix.net>
+ *
+ * This file is part of libautoptr.
+ *
+ * libautoptr is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libautoptr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libautoptr.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+#include "autoptr_private.h"
+#include <libautoptr/autoptr_weak.h>
+#include <string.h>
+
+#if AUTOPTR_WEAK
+
+/*
+ * Weak references and the destroying thread agree on expiry through the reference count alone: an upgrade
+ * increments the count unless it is AUTOPTR_EXPIRED, and the destroying thread moves the count from zero to
+ * AUTOPTR_EXPIRED. The weak count carries one extra count for the bound references, dropped once the set is
+ * destroyed, so that whichever of the destroying thread and the last weak reference finishes last releases the
+ * storage.
+ */
+
+bool __autoptr_expire(struct autoptr *manager)
+{
+#if AUTOPTR_ATOMIC
+        // No weak reference exists, and none can be bound without a bound reference
+        if (atomic_load_explicit(&manager->w_count, memory_order_acquire) == 1)
+                return true;
+
+        // Either the count is still zero and the set expires, or weak references were upgraded meanwhile and
+        // the caller releases its ownership to them
+        int r_count = 0;
+        while (!atomic_compare_exchange_weak_explicit(&manager->r_count, &r_count,
+                                                      r_count == 0 ? AUTOPTR_EXPIRED : r_count - 1,
+                                                      memory_order_acq_rel, memory_order_acquire))
+                ;
+        return (r_count == 0);
+#else
+        AUTOPTR_LOCK(manager);
+        const bool expire = (manager->r_count == 0);
+        if (manager->w_count > 1)
+                manager->r_count = expire ? AUTOPTR_EXPIRED : manager->r_count - 1;
+        else
+                assert(expire);
+        AUTOPTR_UNLOCK(manager);
+        return expire;
+#endif
+}
+
+bool __autoptr_expired(struct autoptr *manager)
+{
+#if AUTOPTR_ATOMIC
+        return atomic_load_explicit(&manager->r_count, memory_order_acquire) == AUTOPTR_EXPIRED;
+#else
+        AUTOPTR_LOCK(manager);
+        const bool expired = (manager->r_count == AUTOPTR_EXPIRED);
+        AUTOPTR_UNLOCK(manager);
+        return expired;
+#endif
+}
+
+/*
+ * Drops one weak count. Returns true if it was the last one, in which case the caller releases the storage.
+ */
+static bool weak_put(struct autoptr *manager)
+{
+#if AUTOPTR_ATOMIC
+        return atomic_fetch_sub_explicit(&manager->w_count, 1, memory_order_acq_rel) == 1;
+#else
+        AUTOPTR_LOCK(manager);
+        const bool last = (--manager->w_count == 0);
+        AUTOPTR_UNLOCK(manager);
+        return last;
+#endif
+}
+
+static void weak_get(struct autoptr *manager)
+{
+#if AUTOPTR_ATOMIC
+        atomic_fetch_add_explicit(&manager->w_count, 1, memory_order_relaxed);
+#else
+        AUTOPTR_LOCK(manager);
+        manager->w_count++;
+        AUTOPTR_UNLOCK(manager);
+#endif
+}
+
+/*
+ * Clears the header kept for the weak references of an expired set and frees its storage if heap-allocated
+ */
+static void release_storage(struct autoptr *manager)
+{
+        const struct autoptr_storage storage = __autoptr_storage(manager);
+
+        __autoptr_lock_destroy(manager);
+        memset(manager, 0, sizeof(*manager));
+
+        __autoptr_free(manager, &storage);
+}
+
+void __autoptr_expired_release(struct autoptr *manager)
+{
+        if (weak_put(manager))
+                release_storage(manager);
+}
+
+void autoptr_weak_bind(struct autoptr_weak *weak, void *ptr)
+{
+        weak->ptr     = ptr;
+        weak->manager = NULL;
+
+        if (ptr == NULL)
+                return;
+
+        autoptr_assert(ptr);
+        weak->manager = AUTOPTR_M(ptr);
+        weak_get(weak->manager);
+}
+
+void autoptr_weak_copy(struct autoptr_weak *weak, const struct autoptr_weak *other)
+{
+        *weak = *other;
+
+        if (weak->ptr != NULL)
+                weak_get(weak->manager);
+}
+
+void autoptr_weak_unbind(struct autoptr_weak *weak)
+{
+        if (weak->ptr == NULL)
+                return;
+
+        if (weak_put(weak->manager))
+                release_storage(weak->manager);
+
+        weak->ptr     = NULL;
+        weak->manager = NULL;
+}
+
+void *autoptr_weak_lock(const struct autoptr_weak *weak)
+{
+        if (weak->ptr == NULL)
+                return NULL;
+
+        struct autoptr *manager = weak->manager;
+
+#if AUTOPTR_ATOMIC
+        // Acquire pairs with the release of the bound references, as for the destroying thread
+        int r_count = atomic_load_explicit(&manager->r_count, memory_order_relaxed);
+        do {
+                if (r_count == AUTOPTR_EXPIRED)
+                        return NULL;
+        } while (!atomic_compare_exchange_weak_explicit(&manager->r_count, &r_count, r_count + 1,
+                                                        memory_order_acquire, memory_order_relaxed));
+#else
+        AUTOPTR_LOCK(manager);
+        const bool expired = (manager->r_count == AUTOPTR_EXPIRED);
+        if (!expired)
+                manager->r_count++;
+        AUTOPTR_UNLOCK(manager);
+
+        if (expired)
+                return NULL;
+#endif
+        AUTOPTR_STATS_COUNT(manager, AUTOPTR_STATS_BIND, 1);
+        return weak->ptr;
+}
+
+bool autoptr_weak_expired(const struct autoptr_weak *weak)
+{
+        return weak->ptr == NULL || __autoptr_expired(weak->manager);
+}
+
+#endif // AUTOPTR_WEAK
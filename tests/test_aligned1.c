@@ -0,0 +1,66 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "test_common.h"
+#include <libautoptr/autoptr.h>
+#include <libautoptr/autoptr_aligned.h>
+
+#define NUM_OBJ 100
+
+static struct test *test_aligned_valloc(size_t obj_len, size_t n)
+{
+        char *v = autoptr_aligned_valloc(obj_len, n);
+        assert(v != NULL);
+        assert(((uintptr_t)v & (AUTOPTR_CACHE_LINE - 1)) == 0);
+
+        for (size_t i = 0; i < n; ++i) {
+                struct test *t = (struct test *)(v + i * obj_len);
+
+                assert(t->data == 0);
+                test_ctor(t);
+                // Constructed with the padded length
+                autoptr_set_obj(t, obj_len, (void (*)(void *))test_dtor);
+        }
+        autoptr_aligned_set_allocd(v);
+        autoptr_set_managed(v, n);
+
+        return (struct test *)v;
+}
+
+int main(int argc, char **argv)
+{
+        assert(autoptr_aligned_stride(1) == AUTOPTR_CACHE_LINE);
+        assert(autoptr_aligned_stride(AUTOPTR_CACHE_LINE) == AUTOPTR_CACHE_LINE);
+        assert(autoptr_aligned_stride(AUTOPTR_CACHE_LINE + 1) == 2 * AUTOPTR_CACHE_LINE);
+
+        // Single objects
+        struct test *t = autoptr_aligned_alloc(sizeof(*t));
+        assert(t != NULL && ((uintptr_t)t & (AUTOPTR_CACHE_LINE - 1)) == 0);
+        test_ctor(t);
+        autoptr_aligned_set_allocd(t);
+        assert(autoptr_get_allocd(t));
+
+        struct test *p = autoptr_bind(t);
+        autoptr_free_obj((void **)&t);
+        assert(test_initd == 1);
+        autoptr_unbind((void **)&p);
+        assert(!test_initd);
+
+        // Vectors of objects padded to whole cache lines
+        const size_t stride = autoptr_aligned_stride(sizeof(struct test));
+        struct test *v      = test_aligned_valloc(stride, NUM_OBJ);
+        assert(test_initd == NUM_OBJ);
+        assert(autoptr_num_managed(v) == NUM_OBJ);
+        autoptr_vfree_obj((void **)&v, NUM_OBJ);
+        assert(!test_initd);
+
+        // Mapped vectors
+        const size_t num_mapped = AUTOPTR_ALIGNED_MAP_LEN / sizeof(struct test) + 1;
+        v                       = test_aligned_valloc(sizeof(struct test), num_mapped);
+        assert(test_initd == (int)num_mapped);
+        autoptr_vfree_obj((void **)&v, num_mapped);
+        assert(!test_initd);
+
+        return 0;
+}
@@ -0,0 +1,82 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include "test_common.h"
+#include <libautoptr/autoptr.h>
+
+#define NUM_OBJ 10
+
+struct counting {
+        size_t num_allocs;
+        size_t num_frees;
+        size_t len;
+};
+
+static void *counting_alloc(size_t len, void *ctx)
+{
+        struct counting *c = ctx;
+
+        ++c->num_allocs;
+        c->len += len;
+        return malloc(len);
+}
+
+static void counting_free(void *ptr, size_t len, void *ctx)
+{
+        struct counting *c = ctx;
+
+        ++c->num_frees;
+        c->len -= len;
+        free(ptr);
+}
+
+int main(int argc, char **argv)
+{
+        struct counting counting         = {0};
+        struct autoptr_allocator counted = {counting_alloc, counting_free, &counting};
+
+        // One-call allocation and construction
+        struct test *t = autoptr_alloc(sizeof(*t), (void (*)(void *))test_dtor);
+        assert(t != NULL && autoptr_get_allocd(t));
+        assert(autoptr_num_references(t) == 0 && t->data == 0);
+        ++test_initd;
+        autoptr_free_obj((void **)&t);
+        assert(!test_initd);
+
+        struct test *v = autoptr_valloc(sizeof(*v), NUM_OBJ, (void (*)(void *))test_dtor);
+        assert(v != NULL && autoptr_num_managed(v) == NUM_OBJ);
+        for (size_t i = 0; i < NUM_OBJ; ++i)
+                assert(v[i].__autoptr.manager == &v->__autoptr && v[i].data == 0);
+        test_initd += NUM_OBJ;
+        autoptr_vfree_obj((void **)&v, NUM_OBJ);
+        assert(!test_initd);
+
+        // The allocator frees what it allocated, with the length of the set
+        v = autoptr_valloc_with(&counted, sizeof(*v), NUM_OBJ, (void (*)(void *))test_dtor);
+        assert(v != NULL && counting.num_allocs == 1 && counting.len == NUM_OBJ * sizeof(*v));
+        test_initd += NUM_OBJ;
+
+        struct test *p = autoptr_bind(v + 3);
+        autoptr_vfree_obj((void **)&v, NUM_OBJ);
+        assert(counting.num_frees == 0);
+        autoptr_unbind((void **)&p);
+        assert(counting.num_frees == 1 && counting.len == 0);
+        assert(!test_initd);
+
+        t = autoptr_alloc_with(&counted, sizeof(*t), (void (*)(void *))test_dtor);
+        assert(t != NULL && counting.num_allocs == 2);
+        ++test_initd;
+        autoptr_free_obj((void **)&t);
+        assert(counting.num_frees == 2 && counting.len == 0);
+
+        // Objects allocated by hand
+        t = counting_alloc(sizeof(*t), &counting);
+        test_ctor(t);
+        autoptr_set_allocator(t, &counted);
+        assert(autoptr_get_allocd(t));
+        autoptr_free_obj((void **)&t);
+        assert(counting.num_frees == 3 && counting.len == 0);
+        assert(!test_initd);
+
+        return 0;
+}
@@ -0,0 +1,115 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include <libautoptr/autoptr.h>
+#include <libautoptr/autoptr_teardown.h>
+
+#define NUM_OBJ 10
+#define NUM_TEARDOWN 10000
+#define NUM_THREADS 8
+
+struct elem {
+        struct autoptr __autoptr;
+        int data;
+};
+
+static size_t num_destroyed = 0;
+static size_t num_last      = 0;
+
+static void elem_dtor(struct elem *e)
+{
+        if (!autoptr_release_last(e))
+                return;
+
+        assert(e->data == 42);
+        __atomic_add_fetch(&num_destroyed, 1, __ATOMIC_RELAXED);
+
+        autoptr_dtor(e);
+}
+
+static struct elem *elem_valloc(size_t n)
+{
+        struct elem *v = calloc(n, sizeof(*v));
+        assert(v != NULL);
+
+        for (size_t i = 0; i < n; ++i) {
+                autoptr_ctor(v + i, sizeof(*v), (void (*)(void *))elem_dtor);
+                v[i].data = 42;
+        }
+        autoptr_set_allocd(v, true);
+        autoptr_set_managed(v, n);
+
+        num_destroyed = 0;
+        return v;
+}
+
+static void *release_main(void *arg)
+{
+        struct elem *e = arg;
+
+        if (autoptr_release_last(e)) {
+                __atomic_add_fetch(&num_last, 1, __ATOMIC_RELAXED);
+                autoptr_destroy(e);
+        }
+        return NULL;
+}
+
+int main(int argc, char **argv)
+{
+        // A destructor called on a shared object only releases it
+        struct elem *e = elem_valloc(1);
+        struct elem *p = autoptr_bind(e);
+        autoptr_free_obj((void **)&e);
+        assert(num_destroyed == 0 && autoptr_num_references(p) == 0);
+        autoptr_unbind((void **)&p);
+        assert(num_destroyed == 1);
+
+        // Each object of a set is destroyed once
+        struct elem *v = elem_valloc(NUM_OBJ);
+        p              = autoptr_bind(v + 3);
+        autoptr_vfree_obj((void **)&v, NUM_OBJ);
+        assert(num_destroyed == 0);
+        autoptr_unbind((void **)&p);
+        assert(num_destroyed == NUM_OBJ);
+
+        // Releasing outside of a destructor
+        e = elem_valloc(1);
+        p = autoptr_bind(e);
+        assert(!autoptr_release_last(p));
+        assert(autoptr_release_last(e));
+        autoptr_destroy(e);
+        assert(num_destroyed == 1);
+
+        // Exactly one of concurrent releases sees the last ownership go
+        e = elem_valloc(1);
+        for (size_t n = 0; n < NUM_THREADS; ++n)
+                autoptr_bind(e);
+        assert(!autoptr_release_last(e));
+#if AUTOPTR_BIASED
+        // Handed off for good, so that the other threads can tell the last reference
+        autoptr_biased_merge(e);
+#endif
+#if AUTOPTR_THREAD_SAFE
+        pthread_t threads[NUM_THREADS];
+        for (size_t n = 0; n < NUM_THREADS; ++n)
+                assert(pthread_create(&threads[n], NULL, release_main, e) == 0);
+        for (size_t n = 0; n < NUM_THREADS; ++n)
+                pthread_join(threads[n], NULL);
+#else
+        // Objects may not be shared between threads in this build
+        for (size_t n = 0; n < NUM_THREADS; ++n)
+                release_main(e);
+#endif
+        assert(num_last == 1 && num_destroyed == 1);
+
+        // The destructors run by the teardown workers
+        assert(autoptr_teardown_start(3, NUM_OBJ) == 0);
+        v = elem_valloc(NUM_TEARDOWN);
+        autoptr_set_independent(v);
+        autoptr_vfree_obj((void **)&v, NUM_TEARDOWN);
+        assert(num_destroyed == NUM_TEARDOWN);
+        autoptr_teardown_stop();
+
+        return 0;
+}
@@ -0,0 +1,55 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "test_common.h"
+#include <libautoptr/autoptr.h>
+
+#define NUM_THREADS 8
+#define NUM_ITER 100000
+
+static void *bind_unbind(void *arg)
+{
+        struct test *t = arg;
+
+        for (size_t n = 0; n < NUM_ITER; ++n) {
+                struct test *p = autoptr_bind(t);
+                assert(p->data == 42);
+                autoptr_unbind((void **)&p);
+                assert(p == NULL);
+        }
+        return NULL;
+}
+
+int main(int argc, char **argv)
+{
+        struct test *t = test_valloc(3);
+
+#if AUTOPTR_THREAD_SAFE
+        pthread_t threads[NUM_THREADS];
+
+        // Contend on the manager count through different elements of the vector
+        for (size_t n = 0; n < NUM_THREADS; ++n)
+                assert(pthread_create(&threads[n], NULL, bind_unbind, &t[n % 3]) == 0);
+
+        for (size_t n = 0; n < NUM_THREADS; ++n)
+                assert(pthread_join(threads[n], NULL) == 0);
+#else
+        // Objects may not be shared between threads in this build
+        for (size_t n = 0; n < NUM_THREADS; ++n)
+                bind_unbind(&t[n % 3]);
+#endif
+
+        // All shared references were unbound
+        assert(autoptr_num_references(t) == 0);
+        assert(autoptr_destroy_ok(t));
+        assert(test_initd == 3);
+
+        autoptr_vfree_obj((void **)&t, 3);
+        assert(t == NULL);
+
+        // Ensure that destructor callback was called
+        assert(!test_initd);
+
+        return 0;
+}
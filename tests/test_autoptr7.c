@@ -0,0 +1,88 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include "test_common.h"
+#include <libautoptr/autoptr.h>
+
+struct test_derived {
+        struct test base;
+        double value[4];
+};
+
+static void test_derived_dtor(struct test_derived *d)
+{
+        if (!autoptr_destroy_ok(d)) {
+                autoptr_release(d);
+                return;
+        }
+
+        // Zeros the whole derived object since the object length was reassigned
+        test_dtor(&d->base);
+        for (size_t i = 0; i < 4; ++i)
+                assert(d->value[i] == 0.0);
+}
+
+static void test_derived_ctor(struct test_derived *d)
+{
+        test_ctor(&d->base);
+        autoptr_set_obj(d, sizeof(*d), (void (*)(void *))test_derived_dtor);
+
+        for (size_t i = 0; i < 4; ++i)
+                d->value[i] = 1.0;
+}
+
+int main(int argc, char **argv)
+{
+#if AUTOPTR_COMPACT
+        // Documented size guarantee of the compact header
+        assert(sizeof(struct autoptr) <= 16);
+        assert(sizeof(struct autoptr) <= 2 * sizeof(void *) + 2 * sizeof(int));
+#endif
+
+        // Per-vector metadata is reachable from every element
+        struct test *t = test_valloc(4);
+        for (size_t n = 0; n < 4; ++n) {
+                assert(autoptr_num_managed(&t[n]) == 4);
+                assert(autoptr_get_allocd(&t[n]));
+                assert(t[n].data == 42);
+        }
+
+        struct test *p = autoptr_bind(&t[3]);
+        assert(autoptr_num_references(&t[1]) == 1);
+
+        // Transfer ownership
+        autoptr_release(t);
+        assert(autoptr_destroy_ok(t));
+
+        autoptr_unbind((void **)&p);
+        assert(p == NULL);
+        assert(!test_initd);
+
+        // Stack object
+        struct test s;
+        test_ctor(&s);
+        assert(autoptr_num_managed(&s) == 1);
+        assert(!autoptr_get_allocd(&s));
+        test_dtor(&s);
+        assert(!test_initd);
+
+        // Reassigned object length and destructor
+        struct test_derived *d = calloc(2, sizeof(*d));
+        test_derived_ctor(&d[0]);
+        test_derived_ctor(&d[1]);
+        autoptr_set_allocd(d, true);
+        autoptr_set_managed(d, 2);
+        assert(autoptr_num_managed(&d[1]) == 2);
+
+        struct test_derived *q = autoptr_bind(&d[1]);
+        autoptr_free_obj((void **)&d);
+        assert(d == NULL);
+        assert(test_initd == 2);
+        assert(q->value[0] == 1.0);
+
+        autoptr_unbind((void **)&q);
+        assert(q == NULL);
+        assert(!test_initd);
+
+        return 0;
+}
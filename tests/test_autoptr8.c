@@ -0,0 +1,51 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include "test_common.h"
+#include <libautoptr/autoptr.h>
+
+int main(int argc, char **argv)
+{
+        struct test *t = test_valloc(3);
+        struct test *u = test_valloc(2);
+        struct test *s = test_alloc();
+
+        // Bind the vector to a list of pointers
+        struct test *p[3];
+        autoptr_vbindl(t, 3, (void **)p);
+        assert(autoptr_num_references(t) == 3);
+
+        // Bind a list with references to the same managed sets spread across it
+        struct test *l[6] = {&u[1], s, &t[2], &u[0], s, &t[0]};
+        struct test *q[6];
+        autoptr_lbindl_batch((void **)l, 6, (void **)q);
+        for (size_t n = 0; n < 6; ++n)
+                assert(q[n] == l[n]);
+
+        assert(autoptr_num_references(t) == 5);
+        assert(autoptr_num_references(u) == 2);
+        assert(autoptr_num_references(s) == 2);
+
+        // Transfer ownership
+        autoptr_release(t);
+        autoptr_release(u);
+        autoptr_release(s);
+        assert(test_initd == 6);
+
+        // Unbind the vector references; the list still holds t
+        autoptr_lunbind_batch((void **)p, 3);
+        for (size_t n = 0; n < 3; ++n)
+                assert(p[n] == NULL);
+        assert(autoptr_num_references(t) == 1);
+        assert(test_initd == 6);
+
+        // Unbinding the list destroys every set once
+        autoptr_lunbind_batch((void **)q, 6);
+        for (size_t n = 0; n < 6; ++n)
+                assert(q[n] == NULL);
+
+        // Ensure that destructor callback was called
+        assert(!test_initd);
+
+        return 0;
+}
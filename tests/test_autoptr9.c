@@ -0,0 +1,57 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include "test_common.h"
+#include <libautoptr/autoptr.h>
+
+#define NUM_OBJ 1000
+
+static size_t vdtor_calls = 0;
+
+static void test_vdtor(void *ptr, size_t num_managed)
+{
+        struct test *t = ptr;
+
+        assert(num_managed == NUM_OBJ);
+        for (size_t i = 0; i < num_managed; ++i) {
+                assert(t[i].data == 42);
+                t[i].data = 0;
+        }
+        test_initd -= (int)num_managed;
+        ++vdtor_calls;
+}
+
+int main(int argc, char **argv)
+{
+        // The vector destructor replaces the per-object destructor calls
+        struct test *t = test_valloc(NUM_OBJ);
+        autoptr_set_vdtor(t, test_vdtor);
+
+        struct test *p = autoptr_bind(t + NUM_OBJ - 1);
+        autoptr_vfree_obj((void **)&t, NUM_OBJ);
+        assert(vdtor_calls == 0);
+
+        autoptr_unbind((void **)&p);
+        assert(vdtor_calls == 1);
+        assert(!test_initd);
+
+        // Trivially destructible sets are freed without any destructor call
+        t = test_valloc(NUM_OBJ);
+        autoptr_set_trivial(t);
+        assert(test_initd == NUM_OBJ);
+
+        autoptr_vfree_obj((void **)&t, NUM_OBJ);
+        assert(test_initd == NUM_OBJ);
+        test_initd = 0;
+
+        // Going back to per-object destructor calls
+        t = test_valloc(NUM_OBJ);
+        autoptr_set_vdtor(t, test_vdtor);
+        autoptr_set_vdtor(t, NULL);
+
+        autoptr_vfree_obj((void **)&t, NUM_OBJ);
+        assert(vdtor_calls == 1);
+        assert(!test_initd);
+
+        return 0;
+}
@@ -0,0 +1,109 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "test_common.h"
+#include <libautoptr/autoptr.h>
+
+#define NUM_THREADS 4
+#define NUM_ITER 100000
+
+static void *bind_unbind(void *arg)
+{
+        struct test *t = arg;
+
+        for (size_t n = 0; n < NUM_ITER; ++n) {
+                struct test *p = autoptr_bind(t);
+                assert(p->data == 42);
+                autoptr_unbind((void **)&p);
+        }
+        return NULL;
+}
+
+static void *unbind(void *arg)
+{
+        struct test *p = arg;
+        autoptr_unbind((void **)&p);
+        return NULL;
+}
+
+static void *create_and_exit(void *arg)
+{
+        struct test *t = test_alloc();
+        struct test *p = autoptr_bind(t);
+
+        autoptr_unbind((void **)&t);
+        return p;
+}
+
+int main(int argc, char **argv)
+{
+        pthread_t threads[NUM_THREADS];
+
+        // Owner thread only
+        struct test *t = test_alloc();
+        for (size_t n = 0; n < NUM_ITER; ++n) {
+                struct test *p = autoptr_bind(t);
+                assert(autoptr_num_references(t) == 1);
+                autoptr_unbind((void **)&p);
+        }
+        assert(autoptr_num_references(t) == 0);
+        assert(autoptr_destroy_ok(t));
+
+        // Other threads bind and unbind while the owner holds the object
+#if AUTOPTR_THREAD_SAFE
+        for (size_t n = 0; n < NUM_THREADS; ++n)
+                assert(pthread_create(&threads[n], NULL, bind_unbind, t) == 0);
+
+        bind_unbind(t);
+
+        for (size_t n = 0; n < NUM_THREADS; ++n)
+                assert(pthread_join(threads[n], NULL) == 0);
+#else
+        bind_unbind(t); // Objects may not be shared between threads in this build
+#endif
+
+        assert(autoptr_num_references(t) == 0);
+        assert(autoptr_destroy_ok(t));
+        autoptr_free_obj((void **)&t);
+        assert(!test_initd);
+
+        // A reference counted by the owner is released by another thread; the owner merges and destroys
+        t              = test_alloc();
+        struct test *p = autoptr_bind(t);
+        autoptr_unbind((void **)&t);
+
+        assert(pthread_create(&threads[0], NULL, unbind, p) == 0);
+        assert(pthread_join(threads[0], NULL) == 0);
+#if AUTOPTR_BIASED
+        assert(test_initd == 1);
+        autoptr_biased_drain();
+#endif
+        assert(!test_initd);
+
+#if AUTOPTR_BIASED
+        // Eager merge hands the object off; the last unbind on another thread destroys it
+        t = test_alloc();
+        p = autoptr_bind(t);
+        autoptr_biased_merge(t);
+        autoptr_unbind((void **)&t);
+        assert(test_initd == 1);
+
+        assert(pthread_create(&threads[0], NULL, unbind, p) == 0);
+        assert(pthread_join(threads[0], NULL) == 0);
+        assert(!test_initd);
+#endif
+
+        // The owner thread exits while a reference it counted is still bound
+        void *ret;
+        assert(pthread_create(&threads[0], NULL, create_and_exit, NULL) == 0);
+        assert(pthread_join(threads[0], &ret) == 0);
+        p = ret;
+
+        assert(test_initd == 1);
+        assert(autoptr_num_references(p) == 0);
+        autoptr_unbind((void **)&p);
+        assert(!test_initd);
+
+        return 0;
+}
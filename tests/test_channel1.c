@@ -0,0 +1,137 @@
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "test_common.h"
+#include <libautoptr/autoptr.h>
+#include <libautoptr/autoptr_channel.h>
+
+#define CAPACITY 8
+#define NUM_PRODUCERS 2
+#define NUM_CONSUMERS 2
+#define NUM_ITEMS 20000 // Per producer
+
+struct item {
+        struct autoptr __autoptr;
+        size_t producer;
+        size_t seq;
+};
+
+static struct autoptr_channel *channel;
+static size_t num_live     = 0;
+static size_t num_received = 0;
+
+static void item_dtor(struct item *it)
+{
+        if (!autoptr_destroy_ok(it)) {
+                autoptr_release(it);
+                return;
+        }
+        __atomic_sub_fetch(&num_live, 1, __ATOMIC_RELAXED);
+        autoptr_dtor(it);
+}
+
+static void *produce(void *arg)
+{
+        const size_t producer = (size_t)arg;
+
+        for (size_t n = 0; n < NUM_ITEMS; ++n) {
+                struct item *it = autoptr_alloc(sizeof(*it), (void (*)(void *))item_dtor);
+                assert(it != NULL);
+                __atomic_add_fetch(&num_live, 1, __ATOMIC_RELAXED);
+                it->producer = producer;
+                it->seq      = n;
+
+                // The creator's ownership moves to the consumer
+                while (!autoptr_channel_send(channel, (void **)&it))
+                        sched_yield();
+                assert(it == NULL);
+        }
+        return NULL;
+}
+
+static void *consume(void *arg)
+{
+        size_t last[NUM_PRODUCERS];
+        for (size_t n = 0; n < NUM_PRODUCERS; ++n)
+                last[n] = 0;
+
+        while (__atomic_load_n(&num_received, __ATOMIC_RELAXED) < NUM_PRODUCERS * NUM_ITEMS) {
+                struct item *it = autoptr_channel_recv(channel);
+                if (it == NULL) {
+                        sched_yield();
+                        continue;
+                }
+                // The items of a producer arrive in order
+                assert(it->seq == 0 || it->seq > last[it->producer]);
+                last[it->producer] = it->seq;
+
+                assert(autoptr_num_references(it) == 0);
+                autoptr_free_obj((void **)&it);
+                __atomic_add_fetch(&num_received, 1, __ATOMIC_RELAXED);
+        }
+        return NULL;
+}
+
+int main(int argc, char **argv)
+{
+        // Moving a reference leaves the count alone
+        struct test *t = test_alloc();
+        void *p        = autoptr_bind(t);
+        void *q        = autoptr_move(&p);
+        assert(p == NULL && q == t && autoptr_num_references(t) == 1);
+
+        assert(autoptr_channel_create(SIZE_MAX) == NULL);
+        assert(autoptr_channel_create(SIZE_MAX / 2 + 2) == NULL);
+
+        channel = autoptr_channel_create(3);
+        assert(channel != NULL && autoptr_channel_capacity(channel) == 4);
+        assert(autoptr_channel_recv(channel) == NULL);
+
+        // First in, first out, up to the capacity
+        void *refs[5];
+        for (size_t n = 0; n < 5; ++n)
+                refs[n] = autoptr_bind(t);
+        for (size_t n = 0; n < 4; ++n) {
+                assert(autoptr_channel_send(channel, &refs[n]));
+                assert(refs[n] == NULL);
+        }
+        assert(!autoptr_channel_send(channel, &refs[4]) && refs[4] == t);
+        assert(autoptr_num_references(t) == 6);
+
+        for (size_t n = 0; n < 2; ++n) {
+                void *r = autoptr_channel_recv(channel);
+                assert(r == t);
+                autoptr_unbind(&r);
+        }
+        assert(autoptr_channel_send(channel, &refs[4]));
+        assert(autoptr_num_references(t) == 4);
+
+        // Destroying the channel unbinds what is left; the creator's unbind then destroys the object
+        autoptr_channel_destroy(channel);
+        assert(autoptr_num_references(t) == 1);
+        autoptr_unbind(&q);
+        autoptr_free_obj((void **)&t);
+        assert(test_initd == 0);
+
+        // Producers and consumers on many threads
+        channel = autoptr_channel_create(CAPACITY);
+        pthread_t producers[NUM_PRODUCERS];
+        pthread_t consumers[NUM_CONSUMERS];
+        for (size_t n = 0; n < NUM_CONSUMERS; ++n)
+                assert(pthread_create(&consumers[n], NULL, consume, NULL) == 0);
+        for (size_t n = 0; n < NUM_PRODUCERS; ++n)
+                assert(pthread_create(&producers[n], NULL, produce, (void *)n) == 0);
+        for (size_t n = 0; n < NUM_PRODUCERS; ++n)
+                assert(pthread_join(producers[n], NULL) == 0);
+        for (size_t n = 0; n < NUM_CONSUMERS; ++n)
+                assert(pthread_join(consumers[n], NULL) == 0);
+        assert(num_received == NUM_PRODUCERS * NUM_ITEMS);
+        assert(num_live == 0);
+        assert(autoptr_channel_recv(channel) == NULL);
+        autoptr_channel_destroy(channel);
+
+        return 0;
+}
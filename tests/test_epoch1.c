@@ -0,0 +1,131 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include <libautoptr/autoptr.h>
+#include <libautoptr/autoptr_epoch.h>
+#include <libautoptr/autoptr_slot.h>
+
+#define NUM_READERS 4
+#define NUM_ITER 20000
+#define NUM_WRITES 2000
+
+struct obj {
+        struct autoptr __autoptr;
+        size_t version;
+};
+
+static size_t num_allocd    = 0;
+static size_t num_destroyed = 0;
+
+static void obj_dtor(struct obj *o)
+{
+        if (!autoptr_release_last(o))
+                return;
+
+        assert(o->version != 0);
+        o->version = 0;
+        __atomic_add_fetch(&num_destroyed, 1, __ATOMIC_RELAXED);
+
+        autoptr_dtor(o);
+}
+
+static struct obj *obj_alloc(size_t version)
+{
+        struct obj *o = autoptr_alloc(sizeof(*o), (void (*)(void *))obj_dtor);
+        assert(o != NULL);
+
+        o->version = version;
+        __atomic_add_fetch(&num_allocd, 1, __ATOMIC_RELAXED);
+        return o;
+}
+
+static struct autoptr_slot slot;
+
+static void *reader_main(void *arg)
+{
+        for (size_t n = 0; n < NUM_ITER; ++n) {
+                autoptr_epoch_enter();
+                const struct obj *o = autoptr_epoch_borrow(&slot.ptr);
+                assert(o->version != 0);
+                autoptr_epoch_exit();
+        }
+        return NULL;
+}
+
+static void *writer_main(void *arg)
+{
+        for (size_t version = 2; version < NUM_WRITES; ++version) {
+                struct obj *o = obj_alloc(version);
+
+                autoptr_slot_store(&slot, o);
+                autoptr_unbind((void **)&o);
+        }
+        return NULL;
+}
+
+int main(int argc, char **argv)
+{
+        assert(autoptr_epoch_start() == 0);
+        assert(autoptr_epoch_start() == -1);
+
+        // A set unbound inside an epoch outlives it
+        struct obj *o = obj_alloc(1);
+        autoptr_slot_init(&slot, o);
+        autoptr_unbind((void **)&o);
+
+        autoptr_epoch_enter();
+        autoptr_epoch_enter();
+        const struct obj *b = autoptr_epoch_borrow(&slot.ptr);
+        assert(b->version == 1);
+
+        o = obj_alloc(2);
+        autoptr_slot_store(&slot, o);
+        autoptr_unbind((void **)&o);
+        assert(autoptr_epoch_pending() == 1);
+        assert(autoptr_epoch_collect() == 0 && autoptr_epoch_collect() == 0);
+
+        autoptr_epoch_exit();
+        assert(autoptr_epoch_collect() == 0 && b->version == 1);
+        autoptr_epoch_exit();
+
+        while (autoptr_epoch_pending() != 0)
+                autoptr_epoch_collect();
+        assert(num_destroyed == 1);
+
+        // Sets not allocated on the heap are destroyed synchronously
+        struct obj s;
+        autoptr_ctor(&s, sizeof(s), (void (*)(void *))obj_dtor);
+        s.version     = 1;
+        struct obj *p = &s;
+        autoptr_epoch_enter();
+        autoptr_free_obj((void **)&p);
+        autoptr_epoch_exit();
+        assert(num_destroyed == 2 && autoptr_epoch_pending() == 0);
+        num_destroyed = 1;
+
+        // Borrowing readers against a writer
+        pthread_t readers[NUM_READERS];
+        pthread_t writer;
+
+        for (size_t n = 0; n < NUM_READERS; ++n)
+                assert(pthread_create(&readers[n], NULL, reader_main, NULL) == 0);
+        assert(pthread_create(&writer, NULL, writer_main, NULL) == 0);
+        for (size_t n = 0; n < NUM_READERS; ++n)
+                pthread_join(readers[n], NULL);
+        pthread_join(writer, NULL);
+#if AUTOPTR_BIASED
+        // The object displaced first was released by the writer and is merged by its owner
+        autoptr_biased_drain();
+#endif
+
+        // Stopping destroys every retired set
+        autoptr_epoch_stop();
+        assert(autoptr_epoch_pending() == 0);
+        assert(num_destroyed == num_allocd - 1);
+
+        autoptr_slot_destroy(&slot);
+        assert(num_destroyed == num_allocd);
+
+        return 0;
+}
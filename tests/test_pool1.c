@@ -0,0 +1,122 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "test_common.h"
+#include <libautoptr/autoptr.h>
+#include <libautoptr/autoptr_pool.h>
+
+#define NUM_THREADS 4
+#define NUM_OBJ 1000
+
+static struct test *test_pool_alloc()
+{
+        struct test *t = autoptr_pool_alloc(autoptr_pool_get(sizeof(*t)));
+        assert(t != NULL);
+        assert(t->data == 0);
+
+        test_ctor(t);
+        autoptr_pool_set_allocd(t);
+
+        return t;
+}
+
+struct churn {
+        struct autoptr __autoptr;
+        size_t id;
+};
+
+static void churn_dtor(struct churn *c)
+{
+        if (!autoptr_destroy_ok(c)) {
+                autoptr_release(c);
+                return;
+        }
+        autoptr_dtor(c);
+}
+
+static void *churn(void *arg)
+{
+        struct autoptr_pool *pool = autoptr_pool_get(sizeof(struct churn));
+        struct churn *c[NUM_OBJ];
+
+        for (size_t i = 0; i < 10; ++i) {
+                for (size_t n = 0; n < NUM_OBJ; ++n) {
+                        c[n] = autoptr_pool_alloc(pool);
+                        autoptr_ctor(c[n], sizeof(*c[n]), (void (*)(void *))churn_dtor);
+                        autoptr_pool_set_allocd(c[n]);
+                        c[n]->id = n;
+                }
+                for (size_t n = 0; n < NUM_OBJ; ++n) {
+                        assert(c[n]->id == n);
+                        autoptr_free_obj((void **)&c[n]);
+                }
+        }
+        return NULL;
+}
+
+static pthread_key_t late_key;
+
+// Runs after the magazines of the exiting thread were flushed; the magazines it takes are flushed as well
+static void late_exit(void *arg)
+{
+        struct churn *c = arg;
+        autoptr_free_obj((void **)&c);
+
+        c = autoptr_pool_alloc(autoptr_pool_get(sizeof(*c)));
+        autoptr_ctor(c, sizeof(*c), (void (*)(void *))churn_dtor);
+        autoptr_pool_set_allocd(c);
+        autoptr_free_obj((void **)&c);
+}
+
+static void *churn_late(void *arg)
+{
+        struct churn *c = autoptr_pool_alloc(autoptr_pool_get(sizeof(*c)));
+        autoptr_ctor(c, sizeof(*c), (void (*)(void *))churn_dtor);
+        autoptr_pool_set_allocd(c);
+
+        pthread_setspecific(late_key, c);
+        return NULL;
+}
+
+int main(int argc, char **argv)
+{
+        // Lengths in the same class share a pool
+        assert(autoptr_pool_get(sizeof(struct test)) == autoptr_pool_get(sizeof(struct test) - 1));
+        assert(autoptr_pool_get(16) != autoptr_pool_get(17));
+
+        // Lengths without a class get no pool
+        assert(autoptr_pool_get(0) == NULL);
+        assert(autoptr_pool_get(AUTOPTR_POOL_MAX_OBJ_LEN + 1) == NULL);
+        assert(autoptr_pool_alloc(NULL) == NULL);
+
+        struct test *t  = test_pool_alloc();
+        struct test *p0 = autoptr_bind(t);
+        assert(autoptr_get_allocd(t));
+
+        // Release ownership of primary test object
+        autoptr_release(t);
+
+        autoptr_unbind((void **)&p0);
+        assert(p0 == NULL);
+        assert(!test_initd);
+
+        // The object went back to the pool and is handed out again, zeroed
+        struct test *u = test_pool_alloc();
+        assert(u == t);
+        autoptr_free_obj((void **)&u);
+        assert(!test_initd);
+
+        pthread_t threads[NUM_THREADS];
+        for (size_t n = 0; n < NUM_THREADS; ++n)
+                assert(pthread_create(&threads[n], NULL, churn, NULL) == 0);
+        for (size_t n = 0; n < NUM_THREADS; ++n)
+                assert(pthread_join(threads[n], NULL) == 0);
+
+        // Pooled objects freed and allocated by thread-specific data destructors
+        assert(pthread_key_create(&late_key, late_exit) == 0);
+        assert(pthread_create(&threads[0], NULL, churn_late, NULL) == 0);
+        assert(pthread_join(threads[0], NULL) == 0);
+
+        return 0;
+}
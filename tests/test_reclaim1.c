@@ -0,0 +1,79 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include "test_common.h"
+#include <libautoptr/autoptr.h>
+#include <libautoptr/autoptr_reclaim.h>
+
+int main(int argc, char **argv)
+{
+        assert(autoptr_reclaim_start(4, false) == 0);
+        assert(autoptr_reclaim_start(4, false) == -1);
+
+        struct test *t  = test_valloc(3);
+        struct test *p0 = autoptr_bind(&t[1]);
+
+        // Release ownership of primary test object
+        autoptr_release(t);
+
+        // The last unbind queues the set instead of destroying it
+        autoptr_unbind((void **)&p0);
+        assert(p0 == NULL);
+        assert(test_initd == 3);
+        assert(autoptr_reclaim_pending() == 1);
+
+        assert(autoptr_reclaim_drain() == 1);
+        assert(autoptr_reclaim_pending() == 0);
+        assert(!test_initd);
+
+        // Objects that are not heap-allocated are destroyed synchronously
+        struct test s;
+        test_ctor(&s);
+        struct test *q = autoptr_bind(&s);
+        autoptr_release(&s);
+        autoptr_unbind((void **)&q);
+        assert(!test_initd);
+        assert(autoptr_reclaim_pending() == 0);
+
+        // The queue depth is bounded; a set that does not fit is destroyed synchronously
+        struct test *u[5];
+        for (size_t n = 0; n < 5; ++n)
+                u[n] = test_alloc();
+        for (size_t n = 0; n < 5; ++n)
+                autoptr_free_obj((void **)&u[n]);
+        assert(autoptr_reclaim_pending() == 4);
+        assert(test_initd == 4);
+
+        // Stopping flushes the pending sets
+        autoptr_reclaim_stop();
+        assert(autoptr_reclaim_pending() == 0);
+        assert(!test_initd);
+
+        // A start with another depth reallocates the queue
+        assert(autoptr_reclaim_start(64, false) == 0);
+
+        struct test *v[16];
+        for (size_t n = 0; n < 16; ++n)
+                v[n] = test_alloc();
+        for (size_t n = 0; n < 16; ++n)
+                autoptr_free_obj((void **)&v[n]);
+        assert(autoptr_reclaim_pending() == 16);
+        assert(test_initd == 16);
+
+        autoptr_reclaim_stop();
+        assert(!test_initd);
+
+        // Background reclaimer
+        assert(autoptr_reclaim_start(64, true) == 0);
+
+        for (size_t n = 0; n < 16; ++n)
+                v[n] = test_alloc();
+        for (size_t n = 0; n < 16; ++n)
+                autoptr_free_obj((void **)&v[n]);
+
+        autoptr_reclaim_stop();
+        assert(autoptr_reclaim_pending() == 0);
+        assert(!test_initd);
+
+        return 0;
+}
@@ -0,0 +1,140 @@
+#include <cassert>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <libautoptr/autoptr.hpp>
+
+static int num_nodes = 0;
+
+struct node {
+        struct autoptr autoptr;
+        int value;
+
+        node(int v = 7) : value(v)
+        {
+                if (v < 0)
+                        throw std::invalid_argument("node");
+                ++num_nodes;
+        }
+        ~node()
+        {
+                assert(--num_nodes >= 0);
+                value = 0;
+        }
+};
+
+// Only types starting with their struct autoptr are accepted by the factories
+struct derived : autoptr {
+        int references() { return autoptr_num_references(this); }
+};
+
+struct c_style {
+        struct autoptr __autoptr;
+        int value;
+};
+
+struct misplaced {
+        int value;
+        struct autoptr autoptr;
+};
+
+struct headerless {
+        char data[2 * sizeof(struct autoptr)];
+};
+
+// Not standard-layout: the base class need not be at offset 0
+struct extended : autoptr {
+        int value;
+};
+
+struct polymorphic {
+        struct autoptr autoptr;
+        virtual ~polymorphic() {}
+};
+
+static_assert(__autoptr_cxx::starts_with_autoptr<node>::value, "node");
+static_assert(__autoptr_cxx::starts_with_autoptr<derived>::value, "derived");
+static_assert(__autoptr_cxx::starts_with_autoptr<c_style>::value, "c_style");
+static_assert(!__autoptr_cxx::starts_with_autoptr<misplaced>::value, "misplaced");
+static_assert(!__autoptr_cxx::starts_with_autoptr<headerless>::value, "headerless");
+static_assert(!__autoptr_cxx::starts_with_autoptr<extended>::value, "extended");
+static_assert(!__autoptr_cxx::starts_with_autoptr<polymorphic>::value, "polymorphic");
+
+int main(int argc, char **argv)
+{
+        {
+                autoptr::ref<node> a = autoptr::make_ref<node>(42);
+                assert(a && a->value == 42 && num_nodes == 1);
+                assert(autoptr_num_references(a.get()) == 0);
+
+                // Copies bind
+                autoptr::ref<node> b = a;
+                assert(b == a);
+                assert(autoptr_num_references(a.get()) == 1);
+
+                // Moves leave the count alone
+                autoptr::ref<node> c = std::move(b);
+                assert(b == nullptr && c == a);
+                assert(autoptr_num_references(a.get()) == 1);
+
+                c = nullptr;
+                assert(autoptr_num_references(a.get()) == 0);
+
+                std::vector<autoptr::ref<node>> v(16, a);
+                assert(autoptr_num_references(a.get()) == 16);
+                v.reserve(1024); // Relocation moves
+                assert(autoptr_num_references(a.get()) == 16);
+                v.clear();
+                assert(autoptr_num_references(a.get()) == 0);
+
+                // The destructor runs once the last reference is gone
+                b = a;
+                a.reset();
+                assert(num_nodes == 1);
+        }
+        assert(num_nodes == 0);
+
+        // Adopted references own the ownership they wrap
+        {
+                autoptr::ref<node> a = autoptr::make_ref<node>();
+                node *p              = static_cast<node *>(autoptr_bind(a.get()));
+                autoptr::ref<node> b = autoptr::ref<node>::adopt(p);
+                assert(autoptr_num_references(p) == 1);
+                a.reset();
+                assert(num_nodes == 1 && b->value == 7);
+        }
+        assert(num_nodes == 0);
+
+        // Managed sets
+        {
+                autoptr::ref<node> a = autoptr::make_ref_array<node>(8);
+                assert(num_nodes == 8 && autoptr_num_managed(a.get()) == 8);
+                assert(a[7].value == 7);
+
+                autoptr::ref<node> b = a;
+                a.reset();
+                assert(num_nodes == 8);
+        }
+        assert(num_nodes == 0);
+
+        // Constructor exceptions leave nothing behind
+        bool thrown = false;
+        try {
+                autoptr::make_ref<node>(-1);
+        } catch (const std::invalid_argument &) {
+                thrown = true;
+        }
+        assert(thrown && num_nodes == 0);
+
+        // Managed sets have at least one object
+        thrown = false;
+        try {
+                autoptr::make_ref_array<node>(0);
+        } catch (const std::invalid_argument &) {
+                thrown = true;
+        }
+        assert(thrown && num_nodes == 0);
+
+        return 0;
+}
@@ -0,0 +1,109 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "test_common.h"
+#include <libautoptr/autoptr.h>
+#include <libautoptr/autoptr_region.h>
+
+#define NUM_OBJ 10000
+#define NUM_VEC 8
+
+static struct test *test_region_alloc(struct autoptr_region *region)
+{
+        struct test *t = autoptr_region_alloc(region, sizeof(*t));
+        assert(t != NULL);
+        assert(t->data == 0);
+        assert(((uintptr_t)t & 15) == 0);
+
+        test_ctor(t);
+        autoptr_region_set_allocd(t);
+
+        return t;
+}
+
+static struct test *test_region_valloc(struct autoptr_region *region, size_t n)
+{
+        struct test *t = autoptr_region_valloc(region, sizeof(*t), n);
+        assert(t != NULL);
+
+        for (size_t i = 0; i < n; ++i) {
+                assert(t[i].data == 0);
+                test_ctor(t + i);
+        }
+        autoptr_region_set_allocd(t);
+        autoptr_set_managed(t, n);
+
+        return t;
+}
+
+static void *unbind(void *arg)
+{
+        autoptr_unbind((void **)&arg);
+        return NULL;
+}
+
+int main(int argc, char **argv)
+{
+        struct autoptr_region *region = autoptr_region_create();
+        assert(region != NULL);
+
+        struct test *t  = test_region_alloc(region);
+        struct test *p0 = autoptr_bind(t);
+        assert(!autoptr_get_allocd(t));
+        assert(autoptr_region_live(region) == 1);
+
+        autoptr_release(t);
+        assert(autoptr_region_reset(region) == -1);
+
+        // Destructors run on the last unbind; the storage stays in the region
+        autoptr_unbind((void **)&p0);
+        assert(!test_initd);
+        assert(autoptr_region_live(region) == 0);
+
+        // Objects and vectors spanning several chunks, one of them oversized
+        struct test *obj[NUM_OBJ];
+        struct test *vec[NUM_VEC];
+
+        for (size_t n = 0; n < NUM_OBJ; ++n)
+                obj[n] = test_region_alloc(region);
+        for (size_t n = 0; n < NUM_VEC; ++n)
+                vec[n] = test_region_valloc(region, n == 0 ? AUTOPTR_REGION_MAX_ALLOC_LEN : n + 1);
+        assert(autoptr_region_live(region) == NUM_OBJ + NUM_VEC);
+
+        for (size_t n = 0; n < NUM_OBJ; ++n)
+                autoptr_free_obj((void **)&obj[n]);
+        assert(autoptr_region_reset(region) == -1);
+
+        // Managed sets may be destroyed on other threads
+        for (size_t n = 0; n < NUM_VEC; ++n) {
+                pthread_t thread;
+                struct test *v = autoptr_bind(vec[n] + n);
+
+                autoptr_vfree_obj((void **)&vec[n], n == 0 ? AUTOPTR_REGION_MAX_ALLOC_LEN : n + 1);
+                pthread_create(&thread, NULL, unbind, v);
+                pthread_join(thread, NULL);
+        }
+#if AUTOPTR_BIASED
+        // Releases by other threads are queued to the owner
+        autoptr_biased_drain();
+#endif
+        assert(!test_initd);
+        assert(autoptr_region_live(region) == 0);
+
+        // The storage is handed out again from the start, zeroed
+        assert(autoptr_region_reset(region) == 0);
+        struct test *u = test_region_alloc(region);
+        assert(u == t);
+        autoptr_free_obj((void **)&u);
+
+        // Unmanaged storage does not hold the region
+        int *buf = autoptr_region_alloc(region, 100 * sizeof(*buf));
+        assert(buf != NULL && buf[99] == 0);
+        assert(autoptr_region_reset(region) == 0);
+
+        autoptr_region_destroy(region);
+
+        return 0;
+}
@@ -0,0 +1,84 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include <libautoptr/autoptr.h>
+#include <libautoptr/autoptr_segvec.h>
+
+#define CHUNK_LEN 128
+#define NUM_OBJ 2000
+
+struct elem {
+        struct autoptr __autoptr;
+        size_t index;
+};
+
+static size_t num_destroyed = 0;
+
+static void elem_dtor(struct elem *e)
+{
+        if (!autoptr_release_last(e))
+                return;
+
+        ++num_destroyed;
+        autoptr_dtor(e);
+}
+
+int main(int argc, char **argv)
+{
+        static struct elem *addr[NUM_OBJ];
+        struct autoptr_segvec v;
+
+        autoptr_segvec_init(&v, sizeof(struct elem), CHUNK_LEN - 28, NULL, (void (*)(void *))elem_dtor);
+        assert(autoptr_segvec_chunk_len(&v) == CHUNK_LEN);
+
+        // Objects stay in place while the vector and its directory grow
+        for (size_t n = 0; n < NUM_OBJ; ++n) {
+                struct elem *e = autoptr_segvec_push(&v);
+                assert(e != NULL && e->index == 0);
+
+                e->index = n;
+                addr[n]  = e;
+        }
+        assert(v.len == NUM_OBJ && v.num_chunks == (NUM_OBJ + CHUNK_LEN - 1) / CHUNK_LEN);
+
+        for (size_t n = 0; n < NUM_OBJ; ++n) {
+                struct elem *e = autoptr_segvec_at(&v, n);
+
+                assert(e == addr[n] && e->index == n);
+                assert(e->__autoptr.manager == v.chunks[n / CHUNK_LEN]);
+        }
+        assert(autoptr_num_managed(v.chunks[0]) == CHUNK_LEN);
+
+        // A reference keeps its chunk alive only
+        struct elem *p = autoptr_bind(autoptr_segvec_at(&v, 5));
+        struct elem *q = autoptr_bind(autoptr_segvec_at(&v, 1500));
+
+        const size_t num_chunks = v.num_chunks;
+        autoptr_segvec_destroy(&v);
+        assert(num_destroyed == (num_chunks - 2) * CHUNK_LEN);
+        assert(p->index == 5 && q->index == 1500);
+
+        autoptr_unbind((void **)&p);
+        assert(num_destroyed == (num_chunks - 1) * CHUNK_LEN);
+        autoptr_unbind((void **)&q);
+        assert(num_destroyed == num_chunks * CHUNK_LEN);
+
+        // Truncation releases whole chunks; pushes go on with a new one
+        num_destroyed = 0;
+        autoptr_segvec_init(&v, sizeof(struct elem), CHUNK_LEN, NULL, (void (*)(void *))elem_dtor);
+        for (size_t n = 0; n < 2 * CHUNK_LEN + 10; ++n)
+                ((struct elem *)autoptr_segvec_push(&v))->index = n;
+
+        autoptr_segvec_truncate(&v, 2 * CHUNK_LEN);
+        assert(num_destroyed == CHUNK_LEN && v.len == 2 * CHUNK_LEN && v.num_chunks == 2);
+
+        struct elem *e = autoptr_segvec_push(&v);
+        assert(e->index == 0 && v.num_chunks == 3);
+        assert(((struct elem *)autoptr_segvec_at(&v, CHUNK_LEN))->index == CHUNK_LEN);
+
+        autoptr_segvec_truncate(&v, 0);
+        assert(num_destroyed == 4 * CHUNK_LEN && v.len == 0 && v.num_chunks == 0);
+        autoptr_segvec_destroy(&v);
+
+        return 0;
+}
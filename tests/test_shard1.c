@@ -0,0 +1,113 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "test_common.h"
+#include <libautoptr/autoptr.h>
+
+#if AUTOPTR_SHARDED
+
+#define NUM_THREADS 8
+#define NUM_ITER 20000
+#define NUM_HELD 16
+
+// Binds and unbinds, keeping a few references across iterations so that shards go negative and positive
+static void *bind_unbind(void *arg)
+{
+        void *held[NUM_HELD] = {NULL};
+
+        for (size_t n = 0; n < NUM_ITER; ++n) {
+                void **slot = &held[n % NUM_HELD];
+                if (*slot != NULL)
+                        autoptr_unbind(slot);
+                *slot = autoptr_bind(arg);
+        }
+        for (size_t n = 0; n < NUM_HELD; ++n)
+                autoptr_unbind(&held[n]);
+
+        return NULL;
+}
+
+// Holds a reference and hands it to the creator
+static void *hold(void *arg)
+{
+        return autoptr_bind(arg);
+}
+
+int main(int argc, char **argv)
+{
+        pthread_t threads[NUM_THREADS];
+
+        // Counts are exact while sharded, and the creator's release drains
+        struct test *t = test_alloc();
+        void *p        = autoptr_bind(t);
+        assert(autoptr_set_sharded(t) == 0);
+        assert(autoptr_set_sharded(t) == -1);
+
+        void *q = autoptr_bind(t);
+        assert(autoptr_num_references(t) == 2);
+        autoptr_unbind(&p);
+        assert(autoptr_num_references(t) == 1);
+
+        autoptr_free_obj((void **)&t);
+        assert(test_initd == 1);
+        assert(autoptr_num_references(q) == 0);
+        autoptr_unbind(&q);
+        assert(!test_initd);
+
+        // The destructor pattern drains through autoptr_destroy_ok
+        t = test_alloc();
+        assert(autoptr_set_sharded(t) == 0);
+        p = autoptr_bind(t);
+        assert(!autoptr_destroy_ok(t));
+        autoptr_unbind(&p);
+        test_dtor(t);
+        assert(!test_initd);
+        free(t);
+
+        // Managed sets shard on the manager
+        struct test *v = test_valloc(4);
+        assert(autoptr_set_sharded(v + 2) == 0);
+        void *list[4];
+        autoptr_vbindl(v, 4, list);
+        assert(autoptr_num_references(v) == 4);
+        autoptr_vfree_obj((void **)&v, 4);
+        assert(test_initd == 4);
+        autoptr_lunbind(list, 4);
+        assert(!test_initd);
+
+        // Concurrent binds and unbinds on a hot object; the last unbinder destroys it
+        t = test_alloc();
+        assert(autoptr_set_sharded(t) == 0);
+
+        for (size_t n = 0; n < NUM_THREADS; ++n)
+                assert(pthread_create(&threads[n], NULL, bind_unbind, t) == 0);
+        for (size_t n = 0; n < NUM_THREADS; ++n)
+                assert(pthread_join(threads[n], NULL) == 0);
+        assert(autoptr_num_references(t) == 0);
+
+        // A reference bound on another thread is released after the drain
+        assert(pthread_create(&threads[0], NULL, hold, t) == 0);
+        assert(pthread_join(threads[0], &p) == 0);
+
+        for (size_t n = 1; n < NUM_THREADS; ++n)
+                assert(pthread_create(&threads[n], NULL, bind_unbind, t) == 0);
+        autoptr_free_obj((void **)&t);
+        for (size_t n = 1; n < NUM_THREADS; ++n)
+                assert(pthread_join(threads[n], NULL) == 0);
+
+        assert(test_initd == 1);
+        autoptr_unbind(&p);
+        assert(!test_initd);
+
+        return 0;
+}
+
+#else
+
+int main(int argc, char **argv)
+{
+        return 77;
+}
+
+#endif
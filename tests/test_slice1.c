@@ -0,0 +1,80 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "test_common.h"
+#include <libautoptr/autoptr.h>
+#include <libautoptr/autoptr_slice.h>
+
+#define NUM_OBJ 1000
+#define NUM_THREADS 4
+
+// Each worker owns a shard and unbinds it
+static void *fill(void *arg)
+{
+        struct autoptr_slice *shard = arg;
+
+        for (size_t i = 0; i < shard->len; ++i)
+                ((struct test *)autoptr_slice_at(shard, i))->data = (int)(shard->offset + i);
+        autoptr_slice_unbind(shard);
+        return NULL;
+}
+
+int main(int argc, char **argv)
+{
+        struct test *v = test_valloc(NUM_OBJ);
+
+        // One reference for the whole range, taken through any object of the set
+        struct autoptr_slice s = autoptr_slice_bind(v + 10, 100, 800);
+        assert(s.base == v && s.offset == 100 && s.len == 800 && s.stride == sizeof(*v));
+        assert(autoptr_num_references(v) == 1);
+        assert(autoptr_slice_at(&s, 0) == v + 100 && autoptr_slice_at(&s, 799) == v + 899);
+
+        // Sub-slices borrow the reference
+        struct autoptr_slice sub = autoptr_slice_sub(&s, 200, 100);
+        assert(sub.base == v && sub.offset == 300 && sub.len == 100);
+        assert(autoptr_slice_at(&sub, 0) == v + 300);
+        struct autoptr_slice empty = autoptr_slice_sub(&s, 800, 0);
+        assert(empty.offset == 900 && empty.len == 0);
+        assert(autoptr_num_references(v) == 1);
+
+        // The slice keeps the set alive after the creator lets go
+        autoptr_vfree_obj((void **)&v, NUM_OBJ);
+        assert(test_initd == NUM_OBJ);
+
+        // Shards handed to other threads hold a reference each
+        struct autoptr_slice shards[NUM_THREADS];
+#if AUTOPTR_THREAD_SAFE
+        pthread_t threads[NUM_THREADS];
+#endif
+        const size_t shard_len = s.len / NUM_THREADS;
+        for (size_t n = 0; n < NUM_THREADS; ++n) {
+                struct autoptr_slice part = autoptr_slice_sub(&s, n * shard_len, shard_len);
+                shards[n]                 = autoptr_slice_dup(&part);
+        }
+        assert(autoptr_num_references(s.base) == NUM_THREADS);
+#if AUTOPTR_THREAD_SAFE
+        for (size_t n = 0; n < NUM_THREADS; ++n)
+                assert(pthread_create(&threads[n], NULL, fill, &shards[n]) == 0);
+        for (size_t n = 0; n < NUM_THREADS; ++n) {
+                assert(pthread_join(threads[n], NULL) == 0);
+                assert(shards[n].base == NULL && shards[n].len == 0);
+        }
+#else
+        // Objects may not be shared between threads in this build
+        for (size_t n = 0; n < NUM_THREADS; ++n) {
+                fill(&shards[n]);
+                assert(shards[n].base == NULL && shards[n].len == 0);
+        }
+#endif
+
+        for (size_t i = 0; i < s.len; ++i)
+                assert(((struct test *)autoptr_slice_at(&s, i))->data == (int)(s.offset + i));
+
+        // The unbind of the last slice destroys the set
+        autoptr_slice_unbind(&s);
+        assert(s.base == NULL);
+        assert(test_initd == 0);
+
+        return 0;
+}
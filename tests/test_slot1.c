@@ -0,0 +1,136 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "test_common.h"
+#include <libautoptr/autoptr.h>
+#include <libautoptr/autoptr_slot.h>
+
+#define NUM_READERS 4
+#define NUM_WRITES 2000
+
+// Objects replaced while readers run; the destructors may run on any thread
+struct table {
+        struct autoptr autoptr;
+        size_t version;
+};
+
+static size_t num_tables = 0;
+
+static void table_dtor(struct table *t)
+{
+        if (!autoptr_destroy_ok(t)) {
+                autoptr_release(t);
+                return;
+        }
+
+        t->version = 0;
+        __atomic_sub_fetch(&num_tables, 1, __ATOMIC_RELAXED);
+        autoptr_dtor(t);
+}
+
+static struct table *table_alloc(size_t version)
+{
+        struct table *t = calloc(1, sizeof(*t));
+        autoptr_ctor(t, sizeof(*t), (void (*)(void *))table_dtor);
+        autoptr_set_allocd(t, true);
+
+        t->version = version;
+        __atomic_add_fetch(&num_tables, 1, __ATOMIC_RELAXED);
+        return t;
+}
+
+#if AUTOPTR_THREAD_SAFE
+
+static bool done = false;
+
+static void *reader(void *arg)
+{
+        struct autoptr_slot *slot = arg;
+        size_t last               = 0;
+
+        while (!__atomic_load_n(&done, __ATOMIC_ACQUIRE)) {
+                struct table *t = autoptr_slot_load(slot);
+                assert(t != NULL);
+
+                // A loaded table is alive and versions only move forward
+                assert(t->version >= last && t->version > 0);
+                last = t->version;
+                autoptr_unbind((void **)&t);
+        }
+        return NULL;
+}
+
+#endif
+
+int main(int argc, char **argv)
+{
+        struct autoptr_slot slot;
+
+        // Empty slot
+        autoptr_slot_init(&slot, NULL);
+        assert(autoptr_slot_load(&slot) == NULL);
+
+        // The slot holds its own bound reference
+        struct test *t = test_alloc();
+        autoptr_slot_store(&slot, t);
+        assert(autoptr_num_references(t) == 1);
+
+        struct test *p = autoptr_slot_load(&slot);
+        assert(p == t);
+        assert(autoptr_num_references(t) == 2);
+        autoptr_unbind((void **)&p);
+
+        autoptr_free_obj((void **)&t);
+        assert(test_initd == 1);
+
+        // Failed and successful compare-exchange
+        struct test *u = test_alloc();
+        assert(!autoptr_slot_compare_exchange(&slot, u, NULL));
+        assert(test_initd == 2);
+
+        p = autoptr_slot_load(&slot);
+        assert(autoptr_slot_compare_exchange(&slot, p, u));
+        autoptr_unbind((void **)&p);
+        assert(test_initd == 1);
+
+        // Exchange hands the displaced reference to the caller
+        p = autoptr_slot_exchange(&slot, NULL);
+        assert(p == u);
+        autoptr_free_obj((void **)&u);
+        assert(test_initd == 1);
+        autoptr_unbind((void **)&p);
+        assert(!test_initd);
+
+        autoptr_slot_destroy(&slot);
+
+        // Readers load while a writer publishes new versions
+        struct table *table = table_alloc(1);
+
+        autoptr_slot_init(&slot, table);
+        autoptr_free_obj((void **)&table);
+
+#if AUTOPTR_THREAD_SAFE
+        pthread_t threads[NUM_READERS];
+        for (size_t n = 0; n < NUM_READERS; ++n)
+                assert(pthread_create(&threads[n], NULL, reader, &slot) == 0);
+#endif
+
+        for (size_t n = 2; n <= NUM_WRITES; ++n) {
+                table = table_alloc(n);
+                autoptr_slot_store(&slot, table);
+                autoptr_free_obj((void **)&table);
+        }
+
+#if AUTOPTR_THREAD_SAFE
+        __atomic_store_n(&done, true, __ATOMIC_RELEASE);
+        for (size_t n = 0; n < NUM_READERS; ++n)
+                assert(pthread_join(threads[n], NULL) == 0);
+#endif
+
+        assert(__atomic_load_n(&num_tables, __ATOMIC_RELAXED) == 1);
+        autoptr_slot_destroy(&slot);
+        assert(__atomic_load_n(&num_tables, __ATOMIC_RELAXED) == 0);
+
+        return 0;
+}
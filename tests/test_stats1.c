@@ -0,0 +1,93 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "test_common.h"
+#include <libautoptr/autoptr.h>
+#include <libautoptr/autoptr_stats.h>
+
+#if AUTOPTR_STATS
+
+#define NUM_OBJS 8
+
+static struct autoptr_stats find(void (*obj_dtor)(void *), size_t obj_len)
+{
+        struct autoptr_stats stats[16];
+        const size_t num_types = autoptr_stats_snapshot(stats, 16);
+
+        assert(num_types <= 16);
+        for (size_t n = 0; n < num_types; ++n)
+                if (stats[n].obj_dtor == obj_dtor && stats[n].obj_len == obj_len)
+                        return stats[n];
+
+        return (struct autoptr_stats){.obj_dtor = obj_dtor, .obj_len = obj_len};
+}
+
+// Constructs objects that outlive the thread
+static void *make_objs(void *arg)
+{
+        struct test **t = arg;
+        for (size_t n = 0; n < NUM_OBJS; ++n)
+                t[n] = test_alloc();
+        return NULL;
+}
+
+int main(int argc, char **argv)
+{
+        void (*const dtor)(void *) = (void (*)(void *))test_dtor;
+        struct autoptr_stats s;
+
+        struct test *t = test_alloc();
+        s              = find(dtor, sizeof(*t));
+        assert(s.live == 1 && s.peak == 1 && s.bytes == sizeof(*t));
+        assert(s.binds == 0 && s.unbinds == 0);
+
+        struct test *p = autoptr_bind(t);
+        autoptr_unbind((void **)&p);
+        s = find(dtor, sizeof(*t));
+        assert(s.binds == 1 && s.unbinds == 1);
+
+        // Releasing the creator's ownership is an unbind
+        autoptr_free_obj((void **)&t);
+        s = find(dtor, sizeof(*t));
+        assert(s.live == 0 && s.peak == 1 && s.bytes == 0 && s.unbinds == 2);
+
+        // A managed set counts as objects of the type of its manager
+        struct test *v = test_valloc(4);
+        void *list[4];
+        autoptr_vbindl(v, 4, list);
+        s = find(dtor, sizeof(*v));
+        assert(s.live == 4 && s.peak == 4 && s.binds == 5);
+
+        autoptr_lunbind(list, 4);
+        autoptr_free_obj((void **)&v);
+        s = find(dtor, sizeof(*v));
+        assert(s.live == 0 && s.unbinds == 7);
+
+        // Counters of exited threads are kept; objects destroyed elsewhere are subtracted
+        struct test *objs[NUM_OBJS];
+        pthread_t thread;
+        assert(pthread_create(&thread, NULL, make_objs, objs) == 0);
+        assert(pthread_join(thread, NULL) == 0);
+
+        s = find(dtor, sizeof(*t));
+        assert(s.live == NUM_OBJS && s.bytes == NUM_OBJS * sizeof(*t));
+
+        for (size_t n = 0; n < NUM_OBJS; ++n)
+                autoptr_free_obj((void **)&objs[n]);
+        s = find(dtor, sizeof(*t));
+        assert(s.live == 0 && s.binds == 5 && s.unbinds == 7 + NUM_OBJS);
+
+        autoptr_stats_dump(stdout);
+
+        return 0;
+}
+
+#else
+
+int main(int argc, char **argv)
+{
+        return 77;
+}
+
+#endif
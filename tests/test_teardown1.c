@@ -0,0 +1,121 @@
+#define _GNU_SOURCE
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <libautoptr/autoptr.h>
+#include <libautoptr/autoptr_teardown.h>
+
+#define NUM_OBJ 100000
+#define THRESHOLD 1000
+
+struct elem {
+        struct autoptr __autoptr;
+        size_t index;
+};
+
+static struct elem *vec_base;
+static size_t vec_len;
+static size_t num_destroyed  = 0;
+static size_t last_destroyed = 0;
+static bool in_order         = true;
+
+static void elem_dtor(struct elem *e)
+{
+        if (!autoptr_destroy_ok(e)) {
+                autoptr_release(e);
+                return;
+        }
+        assert(e == vec_base + e->index);
+
+        if (e->index == 0) {
+                // The manager goes last
+                assert(__atomic_load_n(&num_destroyed, __ATOMIC_RELAXED) == vec_len - 1);
+        } else {
+                const size_t last = __atomic_exchange_n(&last_destroyed, e->index, __ATOMIC_RELAXED);
+                if (last != 0 && last != e->index + 1)
+                        __atomic_store_n(&in_order, false, __ATOMIC_RELAXED);
+        }
+        __atomic_add_fetch(&num_destroyed, 1, __ATOMIC_RELAXED);
+
+        autoptr_dtor(e);
+}
+
+static struct elem *elem_valloc(size_t n, bool independent)
+{
+        struct elem *v = calloc(n, sizeof(*v));
+        assert(v != NULL);
+
+        for (size_t i = 0; i < n; ++i) {
+                autoptr_ctor(v + i, sizeof(*v), (void (*)(void *))elem_dtor);
+                v[i].index = i;
+        }
+        autoptr_set_allocd(v, true);
+        autoptr_set_managed(v, n);
+        if (independent)
+                autoptr_set_independent(v);
+
+        num_destroyed  = 0;
+        last_destroyed = 0;
+        in_order       = true;
+        vec_base       = v;
+        vec_len        = n;
+
+        return v;
+}
+
+int main(int argc, char **argv)
+{
+        assert(autoptr_teardown_start(3, THRESHOLD) == 0);
+        assert(autoptr_teardown_start(3, THRESHOLD) == -1);
+
+        // Sets not declared independent keep the strict reverse order
+        struct elem *v = elem_valloc(NUM_OBJ, false);
+        autoptr_vfree_obj((void **)&v, NUM_OBJ);
+        assert(num_destroyed == NUM_OBJ);
+        assert(in_order);
+
+        // Independent sets are torn down by the workers, the manager last
+        v = elem_valloc(NUM_OBJ, true);
+        autoptr_vfree_obj((void **)&v, NUM_OBJ);
+        assert(num_destroyed == NUM_OBJ);
+
+        // Sets below the threshold are destroyed serially
+        v = elem_valloc(THRESHOLD, true);
+        autoptr_vfree_obj((void **)&v, THRESHOLD);
+        assert(num_destroyed == THRESHOLD);
+        assert(in_order);
+
+        autoptr_teardown_stop();
+
+        // Without workers the destroying thread tears down the set alone
+        assert(autoptr_teardown_start(0, THRESHOLD) == 0);
+        v = elem_valloc(NUM_OBJ, true);
+        autoptr_vfree_obj((void **)&v, NUM_OBJ);
+        assert(num_destroyed == NUM_OBJ);
+        autoptr_teardown_stop();
+
+#ifdef __GLIBC__
+        // A worker that cannot be created leaves parallel teardown stopped
+        pthread_attr_t attr, saved;
+        assert(pthread_getattr_default_np(&saved) == 0);
+        assert(pthread_attr_init(&attr) == 0);
+        assert(pthread_attr_setstacksize(&attr, SIZE_MAX / 2) == 0);
+        assert(pthread_setattr_default_np(&attr) == 0);
+        assert(autoptr_teardown_start(3, THRESHOLD) == -1);
+        assert(pthread_setattr_default_np(&saved) == 0);
+        pthread_attr_destroy(&attr);
+        pthread_attr_destroy(&saved);
+
+        v = elem_valloc(NUM_OBJ, true);
+        autoptr_vfree_obj((void **)&v, NUM_OBJ);
+        assert(num_destroyed == NUM_OBJ);
+        assert(in_order);
+
+        assert(autoptr_teardown_start(3, THRESHOLD) == 0);
+        autoptr_teardown_stop();
+#endif
+
+        return 0;
+}
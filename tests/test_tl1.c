@@ -0,0 +1,102 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "test_common.h"
+#include <libautoptr/autoptr.h>
+#include <libautoptr/autoptr_tl.h>
+
+#define NUM_THREADS 4
+#define NUM_ITER 10000
+#define NUM_OBJS (2 * AUTOPTR_TL_SIZE)
+
+// Rebinds the object many times per batch; the releases of each batch are coalesced
+static void *batches(void *arg)
+{
+        for (size_t n = 0; n < NUM_ITER; ++n) {
+                void *p = autoptr_tl_bind(arg);
+                assert(((struct test *)p)->data == 42);
+                autoptr_tl_unbind(&p);
+
+                if (n % 100 == 99)
+                        autoptr_tl_flush();
+        }
+        // The rest is flushed when the thread exits
+        void *p = autoptr_tl_bind(arg);
+        autoptr_tl_unbind(&p);
+        return NULL;
+}
+
+int main(int argc, char **argv)
+{
+        struct test *t = test_alloc();
+
+        // Bind/unbind pairs cancel in the buffer
+        void *p = autoptr_tl_bind(t);
+        assert(autoptr_num_references(t) == 1);
+        autoptr_tl_unbind(&p);
+        assert(p == NULL);
+        assert(autoptr_num_references(t) == 1);
+
+        for (size_t n = 0; n < 10; ++n) {
+                p = autoptr_tl_bind(t);
+                autoptr_tl_unbind(&p);
+        }
+        assert(autoptr_num_references(t) == 1);
+
+        autoptr_tl_flush();
+        assert(autoptr_num_references(t) == 0);
+
+        // A pending release keeps the object alive until the flush
+        p = autoptr_tl_bind(t);
+        autoptr_free_obj((void **)&t);
+        autoptr_tl_unbind(&p);
+        assert(test_initd == 1);
+        autoptr_tl_flush();
+        assert(!test_initd);
+
+        // Mixed with the usual calls
+        t = test_alloc();
+        p = autoptr_bind(t);
+        autoptr_tl_unbind(&p);
+        p = autoptr_tl_bind(t);
+        autoptr_unbind(&p);
+        assert(autoptr_num_references(t) == 0);
+        autoptr_free_obj((void **)&t);
+        assert(!test_initd);
+
+        // More managers than the buffer holds
+        struct test *objs[NUM_OBJS];
+        for (size_t n = 0; n < NUM_OBJS; ++n) {
+                objs[n] = test_alloc();
+                p       = autoptr_tl_bind(objs[n]);
+                autoptr_free_obj((void **)&objs[n]);
+                autoptr_tl_unbind(&p);
+        }
+        assert(test_initd > 0 && test_initd <= AUTOPTR_TL_SIZE);
+        autoptr_tl_flush();
+        assert(!test_initd);
+
+        // Concurrent batches on a shared object
+        pthread_t threads[NUM_THREADS];
+        t = test_alloc();
+
+#if AUTOPTR_THREAD_SAFE
+        for (size_t n = 0; n < NUM_THREADS; ++n)
+                assert(pthread_create(&threads[n], NULL, batches, t) == 0);
+        for (size_t n = 0; n < NUM_THREADS; ++n)
+                assert(pthread_join(threads[n], NULL) == 0);
+#else
+        // Objects may not be shared between threads in this build; the batches run one after the other
+        for (size_t n = 0; n < NUM_THREADS; ++n) {
+                assert(pthread_create(&threads[n], NULL, batches, t) == 0);
+                assert(pthread_join(threads[n], NULL) == 0);
+        }
+#endif
+
+        assert(autoptr_num_references(t) == 0);
+        autoptr_free_obj((void **)&t);
+        assert(!test_initd);
+
+        return 0;
+}
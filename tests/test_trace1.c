@@ -0,0 +1,152 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test_common.h"
+#include <libautoptr/autoptr.h>
+#include <libautoptr/autoptr_tl.h>
+#include <libautoptr/autoptr_trace.h>
+
+#if AUTOPTR_TRACE
+
+#define MAX_EVENTS 64
+
+static struct autoptr_trace_event events[MAX_EVENTS];
+static size_t num_events;
+static uint32_t main_thread;
+
+// Reads back the events of one managed set from a dump
+static struct autoptr_trace_header dump(const void *manager)
+{
+        struct autoptr_trace_header header;
+        FILE *f = tmpfile();
+
+        assert(f != NULL);
+        assert(autoptr_trace_dump(f) == 0);
+        rewind(f);
+
+        assert(fread(&header, sizeof(header), 1, f) == 1);
+        assert(memcmp(header.magic, AUTOPTR_TRACE_MAGIC, sizeof(header.magic)) == 0);
+        assert(header.version == AUTOPTR_TRACE_VERSION && header.event_len == sizeof(struct autoptr_trace_event));
+
+        num_events       = 0;
+        uint64_t last_ns = 0;
+        for (uint64_t n = 0; n < header.num_events; ++n) {
+                struct autoptr_trace_event e;
+                assert(fread(&e, sizeof(e), 1, f) == 1);
+                assert(e.time_ns >= last_ns && e.caller != 0);
+                last_ns = e.time_ns;
+
+                if (e.manager == (uintptr_t)manager) {
+                        assert(num_events < MAX_EVENTS);
+                        events[num_events++] = e;
+                }
+        }
+
+        // Every caller of the events has a record
+        for (uint64_t n = 0; n < header.num_callers; ++n) {
+                struct autoptr_trace_caller c;
+                char name[4096];
+
+                assert(fread(&c, sizeof(c), 1, f) == 1);
+                assert(c.module_len + c.symbol_len <= sizeof(name));
+                assert(fread(name, 1, c.module_len + c.symbol_len, f) == c.module_len + c.symbol_len);
+        }
+        assert(fgetc(f) == EOF);
+        fclose(f);
+
+        return header;
+}
+
+static void *bind_unbind(void *arg)
+{
+        void *p = autoptr_bind(arg);
+        autoptr_unbind(&p);
+        return NULL;
+}
+
+int main(int argc, char **argv)
+{
+        struct test *t = test_alloc();
+        void *m        = t;
+
+        // Bind and unbind, then the creator's unbind destroys the object
+        void *p = autoptr_bind(t);
+        autoptr_release(p);
+        autoptr_retain(p);
+        autoptr_unbind(&p);
+        autoptr_free_obj((void **)&t);
+
+        dump(m);
+        assert(num_events == 6);
+        const int32_t expected[6][3] = {
+            {AUTOPTR_TRACE_BIND, 2, 1},   {AUTOPTR_TRACE_RELEASE, 1, 1}, {AUTOPTR_TRACE_BIND, 2, 1},
+            {AUTOPTR_TRACE_UNBIND, 1, 1}, {AUTOPTR_TRACE_UNBIND, 0, 1},  {AUTOPTR_TRACE_DESTROY, 0, 1},
+        };
+        for (size_t n = 0; n < num_events; ++n) {
+                assert(events[n].event == (uint32_t)expected[n][0] && events[n].ptr == (uintptr_t)m);
+                assert(events[n].count == expected[n][1] && events[n].n == expected[n][2]);
+        }
+        // The operations of main are recorded at their call sites, not in the library
+        assert(events[0].caller != events[2].caller && events[3].caller != events[4].caller);
+        main_thread = events[0].thread;
+
+        // Managed sets record their number of objects when destroyed; other threads record in rings of their own
+        struct test *v = test_valloc(4);
+        m              = v;
+        void *list[4];
+        autoptr_vbindl(v, 4, list);
+
+        pthread_t thread;
+        assert(pthread_create(&thread, NULL, bind_unbind, v + 2) == 0);
+        assert(pthread_join(thread, NULL) == 0);
+
+        autoptr_lunbind(list, 4);
+        autoptr_free_obj((void **)&v);
+
+        const struct autoptr_trace_header header = dump(m);
+        assert(header.num_lost == 0);
+
+        size_t num_other = 0;
+        for (size_t n = 0; n < num_events; ++n) {
+                if (events[n].thread != main_thread) {
+                        assert(events[n].ptr == (uintptr_t)m + 2 * sizeof(*v));
+                        ++num_other;
+                }
+        }
+        assert(num_other == 2);
+        assert(events[num_events - 1].event == AUTOPTR_TRACE_DESTROY && events[num_events - 1].n == 4);
+        assert(events[num_events - 1].count == 0);
+
+        // Coalesced binds and unbinds are recorded at their call sites; the flush records nothing more
+        t = test_alloc();
+        m = t;
+        p = autoptr_tl_bind(t);
+        autoptr_tl_unbind(&p);
+        p = autoptr_tl_bind(t);
+        autoptr_tl_unbind(&p);
+        autoptr_tl_flush();
+        autoptr_free_obj((void **)&t);
+
+        dump(m);
+        assert(num_events == 6);
+        const int32_t coalesced[6] = {
+            AUTOPTR_TRACE_BIND,   AUTOPTR_TRACE_UNBIND, AUTOPTR_TRACE_BIND,
+            AUTOPTR_TRACE_UNBIND, AUTOPTR_TRACE_UNBIND, AUTOPTR_TRACE_DESTROY,
+        };
+        for (size_t n = 0; n < num_events; ++n)
+                assert(events[n].event == (uint32_t)coalesced[n] && events[n].n == 1);
+        assert(events[1].caller != events[3].caller && events[2].caller != events[3].caller);
+
+        return 0;
+}
+
+#else
+
+int main(int argc, char **argv)
+{
+        return 77;
+}
+
+#endif
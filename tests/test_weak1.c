@@ -0,0 +1,134 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "test_common.h"
+#include <libautoptr/autoptr.h>
+#include <libautoptr/autoptr_weak.h>
+
+#define NUM_THREADS 4
+#define NUM_ITER 10000
+
+#if AUTOPTR_WEAK
+
+static void *lock_unbind(void *arg)
+{
+        struct autoptr_weak w;
+        autoptr_weak_copy(&w, arg);
+
+        // Upgrades succeed until the object expires, and fail from then on
+        bool expired = false;
+        for (size_t n = 0; n < NUM_ITER; ++n) {
+                struct test *p = autoptr_weak_lock(&w);
+                if (p == NULL) {
+                        expired = true;
+                        continue;
+                }
+                assert(!expired);
+                assert(p->data == 42);
+                autoptr_unbind((void **)&p);
+        }
+
+        autoptr_weak_unbind(&w);
+        return NULL;
+}
+
+int main(int argc, char **argv)
+{
+        struct autoptr_weak w, w2;
+
+        // Upgrade while alive; fail after the last unbind
+        struct test *t = test_alloc();
+        autoptr_weak_bind(&w, t);
+        assert(!autoptr_weak_expired(&w));
+
+        struct test *p = autoptr_weak_lock(&w);
+        assert(p == t);
+        assert(autoptr_num_references(t) == 1);
+        autoptr_unbind((void **)&p);
+
+        autoptr_free_obj((void **)&t);
+        assert(!test_initd);
+        assert(autoptr_weak_expired(&w));
+        assert(autoptr_weak_lock(&w) == NULL);
+
+        // Copies of an expired weak reference keep the storage until the last one is unbound
+        autoptr_weak_copy(&w2, &w);
+        autoptr_weak_unbind(&w);
+        assert(w.ptr == NULL);
+        assert(autoptr_weak_lock(&w2) == NULL);
+        autoptr_weak_unbind(&w2);
+
+        // An upgraded reference keeps the object alive after the creator unbinds
+        t = test_alloc();
+        autoptr_weak_bind(&w, t);
+        p = autoptr_weak_lock(&w);
+        autoptr_free_obj((void **)&t);
+        assert(test_initd == 1);
+        assert(!autoptr_weak_expired(&w));
+
+        autoptr_unbind((void **)&p);
+        assert(!test_initd);
+        assert(autoptr_weak_expired(&w));
+        autoptr_weak_unbind(&w);
+
+        // The weak reference goes first; the set is freed by its last unbind as usual
+        t = test_alloc();
+        autoptr_weak_bind(&w, t);
+        autoptr_weak_unbind(&w);
+        autoptr_free_obj((void **)&t);
+        assert(!test_initd);
+
+        // Weak reference to an element of a managed set
+        t = test_valloc(3);
+        autoptr_weak_bind(&w, &t[2]);
+        p = autoptr_weak_lock(&w);
+        assert(p == &t[2]);
+        assert(autoptr_num_references(t) == 1);
+        autoptr_unbind((void **)&p);
+
+        autoptr_vfree_obj((void **)&t, 3);
+        assert(!test_initd);
+        assert(autoptr_weak_lock(&w) == NULL);
+        autoptr_weak_unbind(&w);
+
+        // Unbound weak references
+        autoptr_weak_bind(&w, NULL);
+        assert(autoptr_weak_expired(&w));
+        assert(autoptr_weak_lock(&w) == NULL);
+        autoptr_weak_unbind(&w);
+
+        // Concurrent upgrades while the creator unbinds
+        t = test_alloc();
+        autoptr_weak_bind(&w, t);
+#if AUTOPTR_THREAD_SAFE
+        pthread_t threads[NUM_THREADS];
+        for (size_t n = 0; n < NUM_THREADS; ++n)
+                assert(pthread_create(&threads[n], NULL, lock_unbind, &w) == 0);
+
+        autoptr_free_obj((void **)&t);
+
+        for (size_t n = 0; n < NUM_THREADS; ++n)
+                assert(pthread_join(threads[n], NULL) == 0);
+#else
+        // Objects may not be shared between threads in this build
+        lock_unbind(&w);
+        autoptr_free_obj((void **)&t);
+        lock_unbind(&w);
+#endif
+
+        assert(!test_initd);
+        assert(autoptr_weak_expired(&w));
+        autoptr_weak_unbind(&w);
+
+        return 0;
+}
+
+#else
+
+int main(int argc, char **argv)
+{
+        return 77; // Skipped: no weak references in this build
+}
+
+#endif
@@ -0,0 +1,366 @@
+/*
+ * Copyright (c) 2017-2019 Jason Graham <jgraham@compukix.net>
+ *
+ * This file is part of libautoptr.
+ *
+ * libautoptr is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libautoptr is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libautoptr.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+/*
+ * Trace summary
+ *
+ * Reads a trace file written by autoptr_trace_dump() and prints the call sites with the most events and the
+ * lifetimes of the bound references. A reference lives from the event that bound it to the release or unbind
+ * that gave it back; as references are interchangeable, the releases of a managed set are matched with its binds
+ * in order (the oldest bind first). Releases without a bind in the trace (the creators' ownerships, or binds
+ * overwritten in the rings) are counted as unmatched; a destroy ends the matching for its manager, whose address
+ * may be reused by a later set.
+ *
+ * usage: autoptr_trace [-n num_sites] trace_file
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <libautoptr/autoptr_trace.h>
+
+#define NUM_BUCKETS 8 // Lifetime buckets, by decades from 1 us
+
+struct site {
+        struct autoptr_trace_caller record;
+        const char *module;
+        const char *symbol;
+        uint64_t events[AUTOPTR_TRACE_NUM_EVENTS];
+        uint64_t num_events;
+        uint64_t refs;        ///< References bound here and given back within the trace
+        uint64_t lifetime_ns; ///< Sum of their lifetimes
+        uint64_t max_ns;      ///< Longest of their lifetimes
+};
+
+struct pending {
+        uint64_t time_ns;
+        int64_t refs;
+        struct site *site;
+};
+
+struct summary {
+        uint64_t matched;
+        uint64_t unmatched;
+        uint64_t open;
+        uint64_t buckets[NUM_BUCKETS];
+};
+
+static const char *event_names[AUTOPTR_TRACE_NUM_EVENTS] = {"binds", "releases", "unbinds", "destroys"};
+static const char *bucket_names[NUM_BUCKETS] = {"< 1 us",  "< 10 us", "< 100 us", "< 1 ms",
+                                                "< 10 ms", "< 100 ms", "< 1 s",   ">= 1 s"};
+
+static struct autoptr_trace_event *events;
+static struct site *sites;
+static size_t num_sites;
+
+static void *read_file(const char *path, size_t *len)
+{
+        FILE *stream = fopen(path, "rb");
+        char *data   = NULL;
+        size_t size  = 0;
+
+        if (stream == NULL)
+                return NULL;
+
+        for (;;) {
+                char *grown = realloc(data, size + 65536);
+                if (grown == NULL) {
+                        free(data);
+                        data = NULL;
+                        break;
+                }
+                data = grown;
+
+                const size_t num_read = fread(data + size, 1, 65536, stream);
+                size += num_read;
+                if (num_read < 65536)
+                        break;
+        }
+        fclose(stream);
+
+        *len = size;
+        return data;
+}
+
+/*
+ * Finds the site of a caller; the caller records are in address order
+ */
+static struct site *find_site(uint64_t caller)
+{
+        size_t lo = 0;
+        size_t hi = num_sites;
+
+        while (lo < hi) {
+                const size_t mid = lo + (hi - lo) / 2;
+                if (sites[mid].record.caller < caller)
+                        lo = mid + 1;
+                else
+                        hi = mid;
+        }
+        return lo < num_sites && sites[lo].record.caller == caller ? &sites[lo] : NULL;
+}
+
+static void print_site(const struct site *site)
+{
+        if (site->record.module_len == 0) {
+                printf("0x%" PRIx64 "\n", site->record.caller);
+                return;
+        }
+        if (site->record.symbol_len > 0)
+                printf("%.*s ", (int)site->record.symbol_len, site->symbol);
+        printf("(%.*s+0x%" PRIx64 ")\n", (int)site->record.module_len, site->module, site->record.offset);
+}
+
+static int compare_manager(const void *a, const void *b)
+{
+        const struct autoptr_trace_event *ea = &events[*(const size_t *)a];
+        const struct autoptr_trace_event *eb = &events[*(const size_t *)b];
+
+        if (ea->manager != eb->manager)
+                return (ea->manager > eb->manager) - (ea->manager < eb->manager);
+        return (*(const size_t *)a > *(const size_t *)b) - (*(const size_t *)a < *(const size_t *)b);
+}
+
+static int compare_events(const void *a, const void *b)
+{
+        const struct site *sa = *(struct site *const *)a;
+        const struct site *sb = *(struct site *const *)b;
+
+        return (sa->num_events < sb->num_events) - (sa->num_events > sb->num_events);
+}
+
+static int compare_lifetime(const void *a, const void *b)
+{
+        const struct site *sa = *(struct site *const *)a;
+        const struct site *sb = *(struct site *const *)b;
+
+        return (sa->lifetime_ns < sb->lifetime_ns) - (sa->lifetime_ns > sb->lifetime_ns);
+}
+
+static void count_lifetime(struct summary *summary, struct site *site, uint64_t lifetime_ns, int64_t refs)
+{
+        size_t bucket = 0;
+        for (uint64_t limit = 1000; bucket < NUM_BUCKETS - 1 && lifetime_ns >= limit; limit *= 10)
+                ++bucket;
+
+        summary->matched += refs;
+        summary->buckets[bucket] += refs;
+        if (site != NULL) {
+                site->refs += refs;
+                site->lifetime_ns += lifetime_ns * refs;
+                if (lifetime_ns > site->max_ns)
+                        site->max_ns = lifetime_ns;
+        }
+}
+
+/*
+ * Matches the releases of the managed sets with their binds
+ */
+static int match_lifetimes(uint64_t num_events, struct summary *summary)
+{
+        size_t *order           = malloc((num_events + 1) * sizeof(*order));
+        struct pending *pending = malloc((num_events + 1) * sizeof(*pending));
+        int ret                 = -1;
+
+        if (order == NULL || pending == NULL)
+                goto finish;
+
+        for (size_t n = 0; n < num_events; ++n)
+                order[n] = n;
+        qsort(order, num_events, sizeof(*order), compare_manager);
+
+        size_t first = 0;
+        size_t last  = 0;
+        for (size_t n = 0; n < num_events; ++n) {
+                const struct autoptr_trace_event *e = &events[order[n]];
+
+                if (n > 0 && e->manager != events[order[n - 1]].manager) {
+                        for (; first < last; ++first)
+                                summary->open += pending[first].refs;
+                        first = last = 0;
+                }
+
+                switch (e->event) {
+                case AUTOPTR_TRACE_BIND:
+                        pending[last++] = (struct pending){e->time_ns, e->n, find_site(e->caller)};
+                        break;
+                case AUTOPTR_TRACE_RELEASE:
+                case AUTOPTR_TRACE_UNBIND: {
+                        int64_t refs = e->n;
+                        while (refs > 0 && first < last) {
+                                struct pending *p   = &pending[first];
+                                const int64_t taken = p->refs < refs ? p->refs : refs;
+
+                                count_lifetime(summary, p->site, e->time_ns - p->time_ns, taken);
+                                refs -= taken;
+                                if ((p->refs -= taken) == 0)
+                                        ++first;
+                        }
+                        summary->unmatched += refs;
+                        break;
+                }
+                case AUTOPTR_TRACE_DESTROY:
+                        for (; first < last; ++first)
+                                summary->open += pending[first].refs;
+                        first = last = 0;
+                        break;
+                }
+        }
+        for (; first < last; ++first)
+                summary->open += pending[first].refs;
+
+        ret = 0;
+finish:
+        free(pending);
+        free(order);
+        return ret;
+}
+
+int main(int argc, char **argv)
+{
+        size_t max_sites = 20;
+        int opt;
+
+        while ((opt = getopt(argc, argv, "n:")) != -1) {
+                if (opt != 'n')
+                        goto usage;
+                max_sites = strtoul(optarg, NULL, 10);
+        }
+        if (optind != argc - 1)
+                goto usage;
+
+        size_t len;
+        char *data = read_file(argv[optind], &len);
+        if (data == NULL) {
+                fprintf(stderr, "autoptr_trace: cannot read %s\n", argv[optind]);
+                return EXIT_FAILURE;
+        }
+
+        // Header and events
+        struct autoptr_trace_header header;
+        if (len < sizeof(header))
+                goto invalid;
+        memcpy(&header, data, sizeof(header));
+        if (memcmp(header.magic, AUTOPTR_TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+            header.version != AUTOPTR_TRACE_VERSION || header.event_len != sizeof(struct autoptr_trace_event) ||
+            header.num_events > (len - sizeof(header)) / sizeof(struct autoptr_trace_event))
+                goto invalid;
+
+        events = (struct autoptr_trace_event *)(data + sizeof(header));
+
+        // Caller records
+        size_t offset = sizeof(header) + header.num_events * sizeof(struct autoptr_trace_event);
+        if (header.num_callers > (len - offset) / sizeof(struct autoptr_trace_caller))
+                goto invalid;
+        sites = calloc(header.num_callers + 1, sizeof(*sites));
+        if (sites == NULL)
+                goto invalid;
+        for (num_sites = 0; num_sites < header.num_callers; ++num_sites) {
+                struct site *site = &sites[num_sites];
+
+                if (len - offset < sizeof(struct autoptr_trace_caller))
+                        goto invalid;
+                // The records follow strings, so they are not aligned
+                memcpy(&site->record, data + offset, sizeof(site->record));
+                offset += sizeof(struct autoptr_trace_caller);
+                if ((uint64_t)site->record.module_len + site->record.symbol_len > len - offset)
+                        goto invalid;
+                site->module = data + offset;
+                site->symbol = site->module + site->record.module_len;
+                offset += site->record.module_len + site->record.symbol_len;
+        }
+
+        // Events per site and thread
+        uint32_t num_threads = 0;
+        for (size_t n = 0; n < header.num_events; ++n) {
+                const struct autoptr_trace_event *e = &events[n];
+                struct site *site                   = find_site(e->caller);
+
+                if (e->event >= AUTOPTR_TRACE_NUM_EVENTS || site == NULL)
+                        goto invalid;
+                ++site->events[e->event];
+                ++site->num_events;
+                if (e->thread > num_threads)
+                        num_threads = e->thread;
+        }
+
+        const double span_ms =
+            header.num_events > 0 ? (events[header.num_events - 1].time_ns - events[0].time_ns) / 1e6 : 0;
+        printf("%" PRIu64 " events (%" PRIu64 " lost) in %" PRIu32 " thread rings over %.3f ms\n\n", header.num_events,
+               header.num_lost, num_threads, span_ms);
+
+        // Hot call sites
+        struct site **ranked = malloc((num_sites + 1) * sizeof(*ranked));
+        if (ranked == NULL)
+                goto invalid;
+        for (size_t n = 0; n < num_sites; ++n)
+                ranked[n] = &sites[n];
+
+        qsort(ranked, num_sites, sizeof(*ranked), compare_events);
+        printf("Call sites by events\n%10s", "events");
+        for (size_t e = 0; e < AUTOPTR_TRACE_NUM_EVENTS; ++e)
+                printf(" %10s", event_names[e]);
+        printf("  caller\n");
+        for (size_t n = 0; n < num_sites && n < max_sites; ++n) {
+                printf("%10" PRIu64, ranked[n]->num_events);
+                for (size_t e = 0; e < AUTOPTR_TRACE_NUM_EVENTS; ++e)
+                        printf(" %10" PRIu64, ranked[n]->events[e]);
+                printf("  ");
+                print_site(ranked[n]);
+        }
+
+        // Reference lifetimes
+        struct summary summary = {0};
+        if (match_lifetimes(header.num_events, &summary) != 0)
+                goto invalid;
+
+        printf("\nReference lifetimes (bind to release or unbind)\n");
+        printf("%10" PRIu64 " matched\n%10" PRIu64 " unmatched releases (creators' ownerships, lost binds)\n"
+               "%10" PRIu64 " still bound\n",
+               summary.matched, summary.unmatched, summary.open);
+        for (size_t n = 0; n < NUM_BUCKETS; ++n)
+                printf("%10" PRIu64 " %s\n", summary.buckets[n], bucket_names[n]);
+
+        qsort(ranked, num_sites, sizeof(*ranked), compare_lifetime);
+        printf("\nBind sites by reference time held\n%10s %14s %14s  caller\n", "refs", "mean_ns", "max_ns");
+        for (size_t n = 0; n < num_sites && n < max_sites && ranked[n]->refs > 0; ++n) {
+                printf("%10" PRIu64 " %14" PRIu64 " %14" PRIu64 "  ", ranked[n]->refs,
+                       ranked[n]->lifetime_ns / ranked[n]->refs, ranked[n]->max_ns);
+                print_site(ranked[n]);
+        }
+
+        free(ranked);
+        free(sites);
+        free(data);
+        return EXIT_SUCCESS;
+
+invalid:
+        fprintf(stderr, "autoptr_trace: %s is not a valid trace file\n", argv[optind]);
+        free(sites);
+        free(data);
+        return EXIT_FAILURE;
+usage:
+        fprintf(stderr, "usage: autoptr_trace [-n num_sites] trace_file\n");
+        return EXIT_FAILURE;
+}